@@ -21,21 +21,184 @@
 
 #include <linux/clk.h>
 #include <linux/kernel.h>
+#include <linux/module.h>
 #include <linux/platform_device.h>
 #include <linux/dma-mapping.h>
 #include <linux/interrupt.h>
 #include <linux/fb.h>
 #include <linux/init.h>
+#include <linux/wait.h>
+#include <linux/uaccess.h>
+#include <linux/spinlock.h>
+#include <linux/mutex.h>
+#include <linux/workqueue.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/mm.h>
+#include <linux/console.h>
+#include <linux/sched.h>
+#include <linux/ktime.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <asm/div64.h>
 
 #include "ftlcdc100.h"
 
 /*
- * Select a panel configuration
+ * Select the default panel configuration.  Other modes can still be picked
+ * at load time with the mode parameter or through platform data.
  */
 #undef CONFIG_SHARP_LQ057Q3DC02
 #define CONFIG_AUO_A036QN01_CPLD
 #undef CONFIG_PRIME_VIEW_PD035VX2
 
+/*
+ * Module parameters
+ */
+static int defio;
+module_param(defio, bool, 0);
+MODULE_PARM_DESC(defio, "Draw into a cached shadow buffer and copy damaged "
+	"lines to the screen once per frame");
+
+/*
+ * 32bpp modes at half the scanout bandwidth: clients draw XRGB8888 into the
+ * shadow buffer and damaged lines are converted to dithered RGB565 for the
+ * controller.  Implies defio.
+ */
+static int convert;
+module_param(convert, bool, 0);
+MODULE_PARM_DESC(convert, "Show 32bpp modes by converting them to 16bpp "
+	"(implies defio)");
+
+/*
+ * Share of the bus bandwidth the LCD may take on average.  The rest is left
+ * to the CPU and the other bus masters.
+ */
+static unsigned int bus_share = 50;
+module_param(bus_share, uint, 0644);
+MODULE_PARM_DESC(bus_share, "Percentage of the bus bandwidth the LCD may "
+	"use (default 50)");
+
+/*
+ * Mode to start with, in fb_find_mode() syntax: a mode name such as
+ * "a036qn01", or "<xres>x<yres>[-<bpp>][@<refresh>]".
+ */
+static char *mode_option;
+module_param_named(mode, mode_option, charp, 0);
+MODULE_PARM_DESC(mode, "Initial video mode, e.g. a036qn01 or 320x240-16@60");
+
+/*
+ * The controller fetches each frame linearly from FRAME_BASE and cannot wrap
+ * around the end of the buffer, so there is no FBINFO_HWACCEL_YWRAP.  fbcon
+ * scrolls by panning instead and only copies the screen back to the top
+ * when it reaches the end of the virtual area, i.e. once every
+ * (vpages - 1) * yres lines.
+ */
+static int vpages = 2;
+module_param(vpages, int, 0);
+MODULE_PARM_DESC(vpages, "Height of the virtual screen in screens, "
+	"for panning and page flipping (default 2)");
+
+/*
+ * All modes are served from one buffer reserved at probe time.  Modes that
+ * need more than this are refused.  By default it holds the virtual screen
+ * of the initial mode, at 32bpp with convert, so switching to a bigger mode
+ * or a deeper color depth needs a larger vram.
+ */
+static unsigned long vram;
+module_param(vram, ulong, 0);
+MODULE_PARM_DESC(vram, "Frame buffer memory to reserve in bytes "
+	"(default: the virtual screen of the initial mode)");
+
+/*
+ * With fastboot, an LCD already enabled by the boot loader keeps its mode
+ * and picture: the timings are read back instead of reprogrammed, the
+ * visible frame is copied from the boot loader's buffer, and the rest of
+ * our buffer is cleared only after the frame buffer has been registered.
+ * The boot loader's buffer must not be handed to the kernel as system
+ * memory (e.g. use mem=), or the picture may be gone by the time we probe.
+ */
+static int fastboot;
+module_param(fastboot, bool, 0);
+MODULE_PARM_DESC(fastboot, "Take over the mode and picture set up by "
+	"the boot loader");
+
+/*
+ * Underruns are counted over windows of FTLCDC100_UNDERRUN_WINDOW frames;
+ * a window with FTLCDC100_UNDERRUN_LIMIT or more triggers recovery.
+ */
+#define FTLCDC100_UNDERRUN_WINDOW	64
+#define FTLCDC100_UNDERRUN_LIMIT	4
+
+/*
+ * Control registers 0x00 - 0x44 are cached
+ */
+#define FTLCDC100_REG_CACHE_WORDS	(FTLCDC100_OFFSET_GPIO_CONTROL / 4 + 1)
+
+/*
+ * Number of vblank timestamps kept for measuring the frame period
+ */
+#define FTLCDC100_VBLANK_RING		64
+
+struct ftlcdc100_stats {
+	unsigned long underrun;
+	unsigned long next_base;
+	unsigned long vstatus;
+	unsigned long bus_error;
+};
+
+/*
+ * Bytes copied by fb_read and fb_write between reschedule points.
+ */
+#define FTLCDC100_COPY_CHUNK	(64 * 1024)
+
+/*
+ * Number of flips that can wait for vblank.  One buffer is on screen and one
+ * is being rendered, so two queued flips are enough for triple buffering.
+ */
+#define FTLCDC100_FLIP_QUEUE_LEN	2
+
+/*
+ * FRAME_BASE ignores its low six bits
+ */
+#define FTLCDC100_FRAME_BASE_ALIGN	64
+
+/*
+ * Values of the timing and control registers for one mode, as computed by
+ * ftlcdc100_compute_regs() from a struct fb_var_screeninfo.  frame_base is
+ * filled in by ftlcdc100_set_par().
+ */
+struct ftlcdc100_regs {
+	unsigned int clock_polarity;
+	unsigned int htiming;
+	unsigned int vtiming;
+	unsigned int control;
+	unsigned int frame_base;
+	unsigned int pixclock;		/* picoseconds, after rounding */
+};
+
+struct ftlcdc100_flip_entry {
+	unsigned int frame_base;
+	unsigned int yoffset;
+	unsigned int sequence;
+};
+
+/*
+ * Glyph cache for ftlcdc100_imageblit().  Each slot holds, for one fg/bg
+ * pixel pair, all 256 bytes of a 1bpp bitmap expanded to 8 pixels, i.e.
+ * every row of every 8 pixel wide glyph.  Slots are sized for 32bpp.
+ */
+#define FTLCDC100_GLYPH_CACHE_SLOTS	4
+#define FTLCDC100_GLYPH_SPAN_WORDS	8	/* 8 pixels at 32bpp */
+#define FTLCDC100_GLYPH_SLOT_WORDS	(256 * FTLCDC100_GLYPH_SPAN_WORDS)
+
+struct ftlcdc100_glyph_slot {
+	u32 fg;
+	u32 bg;
+	int valid;
+	u32 *spans;
+};
+
 /* 
  * This structure defines the hardware state of the graphics card. Normally
  * you place this in a header file in linux/include/video. This file usually
@@ -44,12 +207,21 @@
  * avoid duplicate work and easy porting of software. 
  */
 struct ftlcdc100 {
+	struct fb_info *info;
 	struct resource *res;
 	void *base;
 	int irq;
 	struct clk *clk;
 	unsigned long clk_value_khz;
 
+	/*
+	 * vram is the write-combined buffer the controller scans out.  In
+	 * deferred I/O mode clients draw into the cached shadow buffer
+	 * instead, and info->screen_base points there.
+	 */
+	void *vram;
+	void *shadow;
+
 	/*
 	 * This pseudo_palette is used _only_ by fbcon, thus
 	 * it only contains 16 entries to match the number of colors supported
@@ -58,6 +230,131 @@ struct ftlcdc100 {
 	 * pseudo_palette is not used. (This might change in the future.)
 	 */
 	u32 pseudo_palette[16];
+
+	/*
+	 * Copy of the hardware palette.  Entries are packed two per word, so
+	 * this is needed to update a single entry.
+	 */
+	u16 palette[FTLCDC100_PALETTE_ENTRIES];
+
+	/*
+	 * vsync_count is incremented by the interrupt handler every time the
+	 * controller latches FRAME_BASE for the next frame (NEXT_BASE
+	 * interrupt).  Waiters sleep on vsync_wait until it changes.
+	 */
+	wait_queue_head_t vsync_wait;
+	unsigned int vsync_count;
+
+	/*
+	 * Flip queue, protected by flip_lock.  The interrupt handler pops one
+	 * entry per frame into FRAME_BASE.  An entry written to FRAME_BASE is
+	 * `latched' (flip_latched) until the next NEXT_BASE interrupt, at which
+	 * point it is on screen and every older buffer is retired.
+	 */
+	spinlock_t flip_lock;
+	struct ftlcdc100_flip_entry flip_queue[FTLCDC100_FLIP_QUEUE_LEN];
+	unsigned int flip_head;
+	unsigned int flip_count;
+	struct ftlcdc100_flip_entry flip_latch;
+	int flip_latched;
+	unsigned int flip_queued;
+	unsigned int flip_displayed;
+	unsigned int flip_yoffset;
+	struct work_struct flip_work;
+
+	/*
+	 * Register set staged by set_par, protected by flip_lock.  The
+	 * interrupt handler programs it during the next vertical blanking and
+	 * advances commit_done to commit_queued.  With commit_async set,
+	 * set_par returns without waiting for that.
+	 */
+	struct ftlcdc100_regs commit_regs;
+	unsigned int commit_yoffset;
+	unsigned int commit_flip;
+	unsigned int commit_queued;
+	unsigned int commit_done;
+	int commit_async;
+
+	/*
+	 * Underrun recovery.  underrun_count counts the underruns in the
+	 * current window of underrun_frames frames.  Too many switch the FIFO
+	 * to request data earlier (fifo_threshold); if that does not help,
+	 * underrun_advice asks userspace for a lighter mode.
+	 */
+	unsigned int underrun_frames;
+	unsigned int underrun_count;
+	int fifo_threshold;
+	int underrun_advice;
+	struct work_struct underrun_work;
+
+	/*
+	 * Interrupt statistics, protected by stats_lock.  vblank_time holds
+	 * the times of the last FTLCDC100_VBLANK_RING NEXT_BASE interrupts;
+	 * vblank_head is the slot to fill next.  stats_work reports new
+	 * errors, bus_error_reported is the count it last reported.
+	 */
+	spinlock_t stats_lock;
+	struct ftlcdc100_stats stats;
+	ktime_t vblank_time[FTLCDC100_VBLANK_RING];
+	unsigned int vblank_head;
+	unsigned long bus_error_reported;
+	struct work_struct stats_work;
+	struct dentry *debugfs;
+
+	/*
+	 * Write flip.  While write_flip is set, each frame written through
+	 * write() goes to the back buffer at write_yoffset and is flipped to
+	 * when it is complete.
+	 */
+	int write_flip;
+	unsigned int write_yoffset;
+
+	/*
+	 * Glyph cache.  Slots are keyed by the pixel values (not palette
+	 * indexes) of fg and bg, so palette changes never hit stale entries;
+	 * set_par invalidates all slots since the pixel format may change.
+	 */
+	struct ftlcdc100_glyph_slot glyph_slot[FTLCDC100_GLYPH_CACHE_SLOTS];
+	unsigned int glyph_victim;
+	u32 *glyph_spans;
+
+	/*
+	 * osd_text is set while a client has an OSD text window enabled;
+	 * otherwise the OSD may be used as a one cell hardware cursor.
+	 * osd_mapped is set if the memory resource reaches the OSD font and
+	 * attribute RAM; without it the OSD cannot be used at all.
+	 */
+	int osd_text;
+	int osd_mapped;
+
+	/*
+	 * Values of the control registers as last written, so they can be
+	 * read without MMIO and restored on resume.
+	 */
+	u32 reg_cache[FTLCDC100_REG_CACHE_WORDS];
+
+	/*
+	 * Deferred I/O.  Lines dirty_y1..dirty_y2 of the shadow buffer still
+	 * have to be copied to vram; the range is empty if dirty_y1 > dirty_y2.
+	 * With convert set, 32bpp modes are scanned out at 16bpp and the
+	 * lines are converted instead of copied.  flush_lock serializes
+	 * flushes from the deferred I/O worker and from flips.
+	 */
+	int defio;
+	int convert;
+	struct fb_deferred_io fbdefio;
+	struct mutex flush_lock;
+
+	/*
+	 * Fast boot.  Bytes zero_start..smem_len of the frame buffer have not
+	 * been cleared yet; zero_work does that after registration.
+	 */
+	int fastboot;
+	unsigned long zero_start;
+	struct work_struct zero_work;
+	spinlock_t damage_lock;
+	unsigned int dirty_y1;
+	unsigned int dirty_y2;
 };
 
 /**
@@ -72,89 +369,205 @@ static struct fb_fix_screeninfo ftlcdc100_default_fix __devinitdata = {
 };
 
 /**
- * ftlcdc100_default_var - Default struct fb_var_screeninfo
- * It is only used in ftlcdc100_probe, so mark it as __devinitdata
+ * ftlcdc100_modedb - Modes of the panels we know about
+ * Used when the platform data does not supply a mode list.  fb_find_mode()
+ * copies the chosen mode and the modelist keeps its own copies, so mark it
+ * as __devinitdata
  */
+static struct fb_videomode ftlcdc100_modedb[] __devinitdata = {
+	{
+		/* Sharp LQ057Q3DC02 */
+		.name		= "lq057q3dc02",
+		.refresh	= 60,
+		.xres		= 320,
+		.yres		= 240,
+		.pixclock	= 171521,
+		.left_margin	= 17,
+		.right_margin	= 17,
+		.upper_margin	= 7,
+		.lower_margin	= 15,
+		.hsync_len	= 17,
+		.vsync_len	= 1,
+		.sync		= FB_SYNC_VERT_HIGH_ACT,
+		.vmode		= FB_VMODE_NONINTERLACED,
+	}, {
+		/* AUO A036QN01 with CPLD */
+		.name		= "a036qn01",
+		.refresh	= 57,
+		.xres		= 320,
+		.yres		= 240,
+		.pixclock	= 171521,
+		.left_margin	= 44,
+		.right_margin	= 6,
+		.upper_margin	= 11,
+		.lower_margin	= 8,
+		.hsync_len	= 21,
+		.vsync_len	= 3,
+		.sync		= 0,
+		.vmode		= FB_VMODE_NONINTERLACED,
+	}, {
+		/* Prime View PD035VX2 */
+		.name		= "pd035vx2",
+		.refresh	= 14,
+		.xres		= 640,
+		.yres		= 480,
+		.pixclock	= 171521,
+		.left_margin	= 44,
+		.right_margin	= 20,
+		.upper_margin	= 16,
+		.lower_margin	= 16,
+		.hsync_len	= 100,
+		.vsync_len	= 19,
+		.sync		= FTLCDC100_SYNC_ICK,
+		.vmode		= FB_VMODE_NONINTERLACED,
+	},
+};
 
+/*
+ * Mode used unless the mode parameter or the platform data select another
+ */
 #ifdef CONFIG_SHARP_LQ057Q3DC02
-static struct fb_var_screeninfo ftlcdc100_default_var __devinitdata = {
-	.xres		= 320,
-	.yres		= 240,
-	.xres_virtual	= 320,
-	.yres_virtual	= 240,
-	.bits_per_pixel	= 16,
-	.pixclock	= 171521,
-	.left_margin	= 17,
-	.right_margin	= 17,
-	.upper_margin	= 7,
-	.lower_margin	= 15,
-	.hsync_len	= 17,
-	.vsync_len	= 1,
-	.vmode		= FB_VMODE_NONINTERLACED,
-	.sync		= FB_SYNC_VERT_HIGH_ACT,
-};
+#define FTLCDC100_DEFAULT_MODE	"lq057q3dc02"
 #endif
 #ifdef CONFIG_AUO_A036QN01_CPLD
-static struct fb_var_screeninfo ftlcdc100_default_var __devinitdata = {
-	.xres		= 320,
-	.yres		= 240,
-	.xres_virtual	= 320,
-	.yres_virtual	= 240,
-	.bits_per_pixel	= 16,
-	.pixclock	= 171521,
-	.left_margin	= 44,
-	.right_margin	= 6,
-	.upper_margin	= 11,
-	.lower_margin	= 8,
-	.hsync_len	= 21,
-	.vsync_len	= 3,
-	.vmode		= FB_VMODE_NONINTERLACED,
-	.sync		= 0,
-};
+#define FTLCDC100_DEFAULT_MODE	"a036qn01"
 #endif
 #ifdef CONFIG_PRIME_VIEW_PD035VX2
-static struct fb_var_screeninfo ftlcdc100_default_var __devinitdata = {
-	.xres		= 640,
-	.yres		= 480,
-	.xres_virtual	= 640,
-	.yres_virtual	= 480,
-	.bits_per_pixel	= 16,
-	.pixclock	= 171521,
-	.left_margin	= 44,
-	.right_margin	= 20,
-	.upper_margin	= 16,
-	.lower_margin	= 16,
-	.hsync_len	= 100,
-	.vsync_len	= 19,
-	.vmode		= FB_VMODE_NONINTERLACED,
-	.sync		= 0,
-};
-#define CONFIG_FTLCDC100_LCD_CLOCK_POLARITY_ICK
+#define FTLCDC100_DEFAULT_MODE	"pd035vx2"
 #endif
 
+#define FTLCDC100_DEFAULT_BPP	16
+
 /******************************************************************************
  * internal functions
  *****************************************************************************/
-static int ftlcdc100_grow_framebuffer(struct fb_info *info,
-	struct fb_var_screeninfo *var)
+/**
+ * ftlcdc100_frame420_size - FRAME420_SIZE field for a YUV420 mode.
+ * @var: frame buffer variable screen structure
+ *
+ * Returns the field value, or negative errno if the controller cannot
+ * scan out YUV420 frames of this size.
+ */
+static int ftlcdc100_frame420_size(const struct fb_var_screeninfo *var)
+{
+	if (var->xres == 320 && var->yres == 240)
+		return FTLCDC100_LCD_FRAME_BASE_FRAME420_320X240;
+
+	if (var->xres == 640 && var->yres == 480)
+		return FTLCDC100_LCD_FRAME_BASE_FRAME420_640X480;
+
+	return -EINVAL;
+}
+
+/**
+ * ftlcdc100_line_length - Bytes per line (of the Y plane in YUV420 mode).
+ * @var: frame buffer variable screen structure
+ */
+static unsigned int ftlcdc100_line_length(const struct fb_var_screeninfo *var)
+{
+	if (var->nonstd == FTLCDC100_NONSTD_YUV420)
+		return var->xres_virtual;
+
+	/* 1, 2 and 4bpp pixels are packed into bytes */
+	return DIV_ROUND_UP(var->xres_virtual * var->bits_per_pixel, 8);
+}
+
+/**
+ * ftlcdc100_frame_size - Bytes of one frame of yres lines.
+ * @var: frame buffer variable screen structure
+ */
+static unsigned long ftlcdc100_frame_size(const struct fb_var_screeninfo *var)
+{
+	unsigned long size = ftlcdc100_line_length(var) * var->yres;
+
+	/* U and V planes are a quarter of the Y plane each */
+	if (var->nonstd == FTLCDC100_NONSTD_YUV420)
+		size += size / 2;
+
+	return size;
+}
+
+/**
+ * ftlcdc100_buffer_size - Bytes of the whole virtual screen.
+ * @var: frame buffer variable screen structure
+ */
+static unsigned long ftlcdc100_buffer_size(const struct fb_var_screeninfo *var)
+{
+	if (var->nonstd == FTLCDC100_NONSTD_YUV420)
+		return ftlcdc100_frame_size(var)
+		     * (var->yres_virtual / var->yres);
+
+	return ftlcdc100_line_length(var) * var->yres_virtual;
+}
+
+/**
+ * ftlcdc100_converting - Return true if @var is scanned out converted.
+ * @ftlcdc100: driver private data
+ * @var: mode as seen by clients
+ */
+static int ftlcdc100_converting(struct ftlcdc100 *ftlcdc100,
+	const struct fb_var_screeninfo *var)
+{
+	return ftlcdc100->convert && var->bits_per_pixel == 32;
+}
+
+/**
+ * ftlcdc100_scanout_var - The mode as the controller scans it out.
+ * @ftlcdc100: driver private data
+ * @var: mode as seen by clients
+ * @scanout: storage for the scanout mode, if it differs from @var
+ *
+ * A converted 32bpp mode is scanned out at 16bpp; the timings, bandwidth
+ * and vram layout must be worked out for that.  Other modes are returned
+ * as they are.
+ */
+static const struct fb_var_screeninfo *ftlcdc100_scanout_var(
+	struct ftlcdc100 *ftlcdc100, const struct fb_var_screeninfo *var,
+	struct fb_var_screeninfo *scanout)
+{
+	if (!ftlcdc100_converting(ftlcdc100, var))
+		return var;
+
+	*scanout = *var;
+	scanout->bits_per_pixel = 16;
+	return scanout;
+}
+
+/**
+ * ftlcdc100_vram_line_length - Bytes per line of vram in the current mode.
+ * @info: frame buffer structure that represents a single frame buffer
+ *
+ * Same as info->fix.line_length, except for converted modes.
+ */
+static unsigned int ftlcdc100_vram_line_length(struct fb_info *info)
+{
+	struct fb_var_screeninfo scanout;
+
+	return ftlcdc100_line_length(ftlcdc100_scanout_var(info->par,
+					&info->var, &scanout));
+}
+
+/**
+ * ftlcdc100_alloc_framebuffer - Reserve the frame buffer memory pool.
+ * @info: frame buffer structure that represents a single frame buffer
+ * @size: size of the pool in bytes
+ *
+ * The pool is allocated once at probe time and every mode is served from
+ * it, so a mode change never allocates, never fails for lack of contiguous
+ * memory, and never moves memory a client may have mapped.
+ *
+ * Returns negative errno on error, or zero on success.
+ */
+static int ftlcdc100_alloc_framebuffer(struct fb_info *info,
+	unsigned long size)
 {
 	struct device *dev = info->device;
 	struct ftlcdc100 *ftlcdc100 = info->par;
-	unsigned int reg;
-	unsigned long smem_len = (var->xres_virtual * var->yres_virtual
-				 * DIV_ROUND_UP(var->bits_per_pixel, 8));
 	unsigned long smem_start;
 	void *screen_base;
+	void *shadow = NULL;
 
-	if (smem_len <= info->fix.smem_len) {
-		/* current framebuffer is big enough */
-		return 0;
-	}
-
-	/*
-	 * Allocate bigger framebuffer
-	 */
-	screen_base = dma_alloc_writecombine(dev, smem_len,
+	screen_base = dma_alloc_writecombine(dev, size,
 				(dma_addr_t *)&smem_start,
 				GFP_KERNEL | GFP_DMA);
 
@@ -163,474 +576,2944 @@ static int ftlcdc100_grow_framebuffer(struct fb_info *info,
 		return -ENOMEM;
 	}
 
-	memset(screen_base, 0, smem_len);
+	/* in fast boot mode, zero_work clears the buffer later */
+	if (!ftlcdc100->fastboot)
+		memset(screen_base, 0, size);
+
 	dev_dbg(dev, "  frame buffer: vitual = %p, physical = %08lx\n",
 		screen_base, smem_start);
 
-	reg = FTLCDC100_LCD_FRAME_BASE(smem_start);
-	iowrite32(reg, ftlcdc100->base + FTLCDC100_OFFSET_LCD_FRAME_BASE);
-
-	/*
-	 * Free current framebuffer (if any)
-	 */
-	if (info->screen_base) {
-		dma_free_writecombine(dev, info->fix.smem_len,
-			info->screen_base, (dma_addr_t )info->fix.smem_start);
+	if (ftlcdc100->defio) {
+		/* deferred I/O needs vmalloc memory to track page faults */
+		shadow = vmalloc(size);
+		if (!shadow) {
+			dev_err(dev, "Failed to allocate shadow buffer\n");
+			dma_free_writecombine(dev, size, screen_base,
+				(dma_addr_t)smem_start);
+			return -ENOMEM;
+		}
+
+		if (!ftlcdc100->fastboot)
+			memset(shadow, 0, size);
 	}
 
-	info->screen_base = screen_base;
+	ftlcdc100->vram = screen_base;
+	ftlcdc100->shadow = shadow;
+	info->screen_base = shadow ? shadow : screen_base;
 	info->fix.smem_start = smem_start;
-	info->fix.smem_len = smem_len;
+	info->fix.smem_len = size;
 
 	return 0;
 }
 
-/******************************************************************************
- * interrupt handler
- *****************************************************************************/
-static irqreturn_t ftlcdc100_interrupt(int irq, void *dev_id)
+/**
+ * ftlcdc100_free_framebuffer - Free what ftlcdc100_alloc_framebuffer allocated.
+ * @info: frame buffer structure that represents a single frame buffer
+ */
+static void ftlcdc100_free_framebuffer(struct fb_info *info)
 {
-	struct fb_info *info = dev_id;
-	struct device *dev = info->device;
 	struct ftlcdc100 *ftlcdc100 = info->par;
-	unsigned int status;
 
-	status = ioread32(ftlcdc100->base + FTLCDC100_OFFSET_LCD_INT_STATUS);
+	dma_free_writecombine(info->device, info->fix.smem_len, ftlcdc100->vram,
+				(dma_addr_t )info->fix.smem_start);
+	vfree(ftlcdc100->shadow);
+}
 
-	if (status & FTLCDC100_LCD_INT_UNDERRUN) {
-		if (printk_ratelimit())
-			dev_notice(dev, "underrun\n");
-	}
+/**
+ * ftlcdc100_write_reg - Write a control register.
+ * @ftlcdc100: driver private data
+ * @offset: register offset
+ * @val: new register value
+ */
+static void ftlcdc100_write_reg(struct ftlcdc100 *ftlcdc100,
+	unsigned int offset, unsigned int val)
+{
+	ftlcdc100->reg_cache[offset / 4] = val;
+	iowrite32(val, ftlcdc100->base + offset);
+}
 
-	if (status & FTLCDC100_LCD_INT_NEXT_BASE) {
-		if (printk_ratelimit())
-			dev_dbg(dev, "frame base updated\n");
-	}
+/**
+ * ftlcdc100_read_reg - Return the value last written to a control register.
+ * @ftlcdc100: driver private data
+ * @offset: register offset
+ */
+static unsigned int ftlcdc100_read_reg(struct ftlcdc100 *ftlcdc100,
+	unsigned int offset)
+{
+	return ftlcdc100->reg_cache[offset / 4];
+}
 
-	if (status & FTLCDC100_LCD_INT_VSTATUS) {
-		if (printk_ratelimit())
-			dev_dbg(dev, "vertical duration reached \n");
+/**
+ * ftlcdc100_update_reg - Write a register unless it already holds @val.
+ * @ftlcdc100: driver private data
+ * @offset: register offset
+ * @val: new register value
+ *
+ * Rewriting timing or control registers with the same value can still
+ * disturb the panel, e.g. when taking over the boot loader's mode.
+ */
+static void ftlcdc100_update_reg(struct ftlcdc100 *ftlcdc100,
+	unsigned int offset, unsigned int val)
+{
+	if (ftlcdc100_read_reg(ftlcdc100, offset) != val)
+		ftlcdc100_write_reg(ftlcdc100, offset, val);
+}
 
-	}
+/*
+ * Registers restored on resume, in order: the LCD is enabled last
+ */
+static const unsigned int ftlcdc100_restore_offsets[] = {
+	FTLCDC100_OFFSET_LCD_CLOCK_POLARITY,
+	FTLCDC100_OFFSET_LCD_HTIMING,
+	FTLCDC100_OFFSET_LCD_VTIMING,
+	FTLCDC100_OFFSET_LCD_FRAME_BASE,
+	FTLCDC100_OFFSET_OSD_SCALING_CONTROL,
+	FTLCDC100_OFFSET_OSD_POSITION_CONTROL,
+	FTLCDC100_OFFSET_OSD_FG_CONTROL,
+	FTLCDC100_OFFSET_OSD_BG_CONTROL,
+	FTLCDC100_OFFSET_LCD_INT_ENABLE,
+	FTLCDC100_OFFSET_LCD_CONTROL,
+};
 
-	if (status & FTLCDC100_LCD_INT_BUS_ERROR) {
-		if (printk_ratelimit())
-			dev_err(dev, "bus error!\n");
+/**
+ * ftlcdc100_load_reg_cache - Fill the register cache from the hardware.
+ * @ftlcdc100: driver private data
+ *
+ * Done once at probe time, so that the boot loader's settings are known.
+ */
+static void ftlcdc100_load_reg_cache(struct ftlcdc100 *ftlcdc100)
+{
+	unsigned int offset;
+	int i;
 
+	for (i = 0; i < ARRAY_SIZE(ftlcdc100_restore_offsets); i++) {
+		offset = ftlcdc100_restore_offsets[i];
+		ftlcdc100->reg_cache[offset / 4] = ioread32(ftlcdc100->base
+							  + offset);
 	}
-
-	iowrite32(status, ftlcdc100->base + FTLCDC100_OFFSET_LCD_INT_CLEAR);
-
-	return IRQ_HANDLED;
 }
 
-/******************************************************************************
- * struct fb_ops functions
- *****************************************************************************/
 /**
- * ftlcdc100_check_var - Validates a var passed in.
- * @var: frame buffer variable screen structure
- * @info: frame buffer structure that represents a single frame buffer 
- *
- * Checks to see if the hardware supports the state requested by
- * var passed in. This function does not alter the hardware state!!! 
- * This means the data stored in struct fb_info and struct ftlcdc100 do 
- * not change. This includes the var inside of struct fb_info. 
- * Do NOT change these. This function can be called on its own if we
- * intent to only test a mode and not actually set it. The stuff in 
- * modedb.c is a example of this. If the var passed in is slightly 
- * off by what the hardware can support then we alter the var PASSED in
- * to what we can do.
- *
- * For values that are off, this function must round them _up_ to the
- * next value that is supported by the hardware.  If the value is
- * greater than the highest value supported by the hardware, then this
- * function must return -EINVAL.
- *
- * Exception to the above rule:  Some drivers have a fixed mode, ie,
- * the hardware is already set at boot up, and cannot be changed.  In
- * this case, it is more acceptable that this function just return
- * a copy of the currently working var (info->var). Better is to not
- * implement this function, as the upper layer will do the copying
- * of the current var for you.
- *
- * Note:  This is the only function where the contents of var can be
- * freely adjusted after the driver has been registered. If you find
- * that you have code outside of this function that alters the content
- * of var, then you are doing something wrong.  Note also that the
- * contents of info->var must be left untouched at all times after
- * driver registration.
+ * ftlcdc100_read_var - Read back the mode programmed by the boot loader.
+ * @info: frame buffer structure that represents a single frame buffer
+ * @var: returned mode
  *
- * Returns negative errno on error, or zero on success.
+ * Returns negative errno if the LCD is not enabled or not in a mode we
+ * can take over, or zero on success.
  */
-static int ftlcdc100_check_var(struct fb_var_screeninfo *var,
-		struct fb_info *info)
+static int ftlcdc100_read_var(struct fb_info *info,
+	struct fb_var_screeninfo *var)
 {
-	struct device *dev = info->device;
 	struct ftlcdc100 *ftlcdc100 = info->par;
-	unsigned long clk_value_khz = ftlcdc100->clk_value_khz;
-	int ret;
+	static const unsigned int bpp[] = { 1, 2, 4, 8, 16, 32 };
+	unsigned int control;
+	unsigned int htiming;
+	unsigned int vtiming;
+	unsigned int polarity;
+	unsigned int divno;
 
-	dev_dbg(dev, "%s:\n", __func__);
+	control = ftlcdc100_read_reg(ftlcdc100, FTLCDC100_OFFSET_LCD_CONTROL);
+	if (!(control & FTLCDC100_LCD_CONTROL_ENABLE))
+		return -ENODEV;
 
-	if (var->pixclock == 0) {
-		dev_err(dev, "pixclock not specified\n");
+	if (control & FTLCDC100_LCD_CONTROL_YUV)
 		return -EINVAL;
-	}
 
-	dev_dbg(dev, "  resolution: %ux%u (%ux%u virtual)\n",
-		var->xres, var->yres,
-		var->xres_virtual, var->yres_virtual);
-	dev_dbg(dev, "  pixclk:       %lu KHz\n", PICOS2KHZ(var->pixclock));
-	dev_dbg(dev, "  bpp:          %u\n", var->bits_per_pixel);
-	dev_dbg(dev, "  clk:          %lu KHz\n", clk_value_khz);
-	dev_dbg(dev, "  left  margin: %u\n", var->left_margin);
-	dev_dbg(dev, "  right margin: %u\n", var->right_margin);
-	dev_dbg(dev, "  upper margin: %u\n", var->upper_margin);
-	dev_dbg(dev, "  lower margin: %u\n", var->lower_margin);
-	dev_dbg(dev, "  hsync:        %u\n", var->hsync_len);
-	dev_dbg(dev, "  vsync:        %u\n", var->vsync_len);
+	if (((control >> 1) & 0x7) >= ARRAY_SIZE(bpp))
+		return -EINVAL;
 
-	if (PICOS2KHZ(var->pixclock) * DIV_ROUND_UP(var->bits_per_pixel, 8)
-			> clk_value_khz) {
-		dev_err(dev, "%lu KHz pixel clock is too fast\n",
-			PICOS2KHZ(var->pixclock));
+	/* a 32bpp picture cannot stay up while we switch to 16bpp scanout */
+	if (ftlcdc100->convert && bpp[(control >> 1) & 0x7] == 32)
 		return -EINVAL;
+
+	htiming = ftlcdc100_read_reg(ftlcdc100, FTLCDC100_OFFSET_LCD_HTIMING);
+	vtiming = ftlcdc100_read_reg(ftlcdc100, FTLCDC100_OFFSET_LCD_VTIMING);
+	polarity = ftlcdc100_read_reg(ftlcdc100,
+			FTLCDC100_OFFSET_LCD_CLOCK_POLARITY);
+
+	/* the inverse of what ftlcdc100_set_par() programs */
+	var->bits_per_pixel = bpp[(control >> 1) & 0x7];
+	var->xres = (((htiming >> 2) & 0x3f) + 1) * 16;
+	var->hsync_len = ((htiming >> 8) & 0xff) + 1;
+	var->right_margin = ((htiming >> 16) & 0xff) + 1;
+	var->left_margin = ((htiming >> 24) & 0xff) + 1;
+	var->yres = (vtiming & 0x3ff) + 1;
+	var->vsync_len = ((vtiming >> 10) & 0x3f) + 1;
+	var->lower_margin = (vtiming >> 16) & 0xff;
+	var->upper_margin = (vtiming >> 24) & 0xff;
+	var->xres_virtual = var->xres;
+	var->yres_virtual = var->yres;
+	var->xoffset = var->yoffset = 0;
+	var->nonstd = 0;
+
+	divno = (polarity & 0x3f) + 1;
+	var->pixclock = KHZ2PICOS(DIV_ROUND_UP(ftlcdc100->clk_value_khz,
+						divno));
+
+	var->sync = 0;
+	if (!(polarity & FTLCDC100_LCD_CLOCK_POLARITY_IHS))
+		var->sync |= FB_SYNC_HOR_HIGH_ACT;
+	if (!(polarity & FTLCDC100_LCD_CLOCK_POLARITY_IVS))
+		var->sync |= FB_SYNC_VERT_HIGH_ACT;
+	if (polarity & FTLCDC100_LCD_CLOCK_POLARITY_ICK)
+		var->sync |= FTLCDC100_SYNC_ICK;
+
+	return 0;
+}
+
+/**
+ * ftlcdc100_copy_splash - Copy the boot loader's picture and palette.
+ * @info: frame buffer structure that represents a single frame buffer
+ *
+ * Copies the visible frame from the buffer the LCD currently scans out to
+ * the start of our buffer, so switching FRAME_BASE over is invisible.
+ */
+static void ftlcdc100_copy_splash(struct fb_info *info)
+{
+	struct device *dev = info->device;
+	struct ftlcdc100 *ftlcdc100 = info->par;
+	unsigned long len = ftlcdc100_frame_size(&info->var);
+	unsigned long phys;
+	unsigned int val;
+	void *splash;
+	int i;
+
+	ftlcdc100->zero_start = len;
+
+	for (i = 0; i < FTLCDC100_PALETTE_ENTRIES; i += 2) {
+		val = ioread32(ftlcdc100->base + FTLCDC100_OFFSET_PALETTE
+				+ i * 2);
+		ftlcdc100->palette[i] = val & 0xffff;
+		ftlcdc100->palette[i + 1] = val >> 16;
 	}
 
-	if (var->xres != info->var.xres)
-		return -EINVAL;
+	phys = FTLCDC100_LCD_FRAME_BASE(ftlcdc100_read_reg(ftlcdc100,
+				FTLCDC100_OFFSET_LCD_FRAME_BASE));
 
-	if (var->yres != info->var.yres)
-		return -EINVAL;
+	splash = ioremap(phys, len);
+	if (!splash) {
+		dev_warn(dev, "Failed to map boot loader frame buffer\n");
+		memset(ftlcdc100->vram, 0, len);
+		if (ftlcdc100->shadow)
+			memset(ftlcdc100->shadow, 0, len);
+		return;
+	}
 
-	if (var->xres_virtual != info->var.xres_virtual)
-		return -EINVAL;
+	memcpy_fromio(ftlcdc100->vram, splash, len);
+	if (ftlcdc100->shadow)
+		memcpy_fromio(ftlcdc100->shadow, splash, len);
 
-	if (var->xres_virtual != info->var.xres)
-		return -EINVAL;
+	iounmap(splash);
+}
 
-	if (var->yres_virtual < info->var.yres)
-		return -EINVAL;
+/**
+ * ftlcdc100_zero_work - Clear the frame buffer beyond the boot picture.
+ * @work: zero_work in struct ftlcdc100
+ *
+ * Runs once after registration in fast boot mode.  The console lock keeps
+ * fbcon from drawing while we clear.
+ */
+static void ftlcdc100_zero_work(struct work_struct *work)
+{
+	struct ftlcdc100 *ftlcdc100 = container_of(work, struct ftlcdc100,
+						   zero_work);
+	struct fb_info *info = ftlcdc100->info;
+	unsigned long start = ftlcdc100->zero_start;
 
-	ret = ftlcdc100_grow_framebuffer(info, var);
-	if (ret)
-		return ret;
+	acquire_console_sem();
 
-	switch (var->bits_per_pixel) {
-	case 1: case 2: case 4: case 8:
-		var->red.offset = var->green.offset = var->blue.offset = 0;
-		var->red.length = var->green.length = var->blue.length
-			= var->bits_per_pixel;
-		break;
+	memset(ftlcdc100->vram + start, 0, info->fix.smem_len - start);
+	if (ftlcdc100->shadow)
+		memset(ftlcdc100->shadow + start, 0,
+			info->fix.smem_len - start);
 
-	case 16:	/* RGB:565 mode */
-		var->red.offset		= 11;
-		var->green.offset	= 5;
-		var->blue.offset	= 0;
+	ftlcdc100->zero_start = info->fix.smem_len;
 
-		var->red.length		= 5;
-		var->green.length	= 6;
-		var->blue.length	= 5;
-		var->transp.length	= 0;
-		break;
+	release_console_sem();
+}
 
-	case 32:	/* RGB:888 mode */
-		var->red.offset		= 16;
-		var->green.offset	= 8;
-		var->blue.offset	= 0;
-		var->transp.offset	= 24;
+/**
+ * ftlcdc100_damage - Mark lines of the shadow buffer dirty.
+ * @info: frame buffer structure that represents a single frame buffer
+ * @y: first dirty line
+ * @height: number of dirty lines
+ *
+ * The lines are flushed to the screen by the deferred I/O worker, at most one
+ * frame later, or by the next FTLCDC100IOC_QUEUE_FLIP.  Does nothing unless
+ * deferred I/O is enabled.
+ */
+static void ftlcdc100_damage(struct fb_info *info, unsigned int y,
+	unsigned int height)
+{
+	struct ftlcdc100 *ftlcdc100 = info->par;
+	unsigned long flags;
 
-		var->red.length = var->green.length = var->blue.length = 8;
-		var->transp.length	= 8;
-		break;
+	if (!ftlcdc100->defio || height == 0)
+		return;
 
-	default:
-		dev_err(dev, "color depth %d not supported\n",
-					var->bits_per_pixel);
-		return -EINVAL;
-	}
+	spin_lock_irqsave(&ftlcdc100->damage_lock, flags);
+	ftlcdc100->dirty_y1 = min(ftlcdc100->dirty_y1, y);
+	ftlcdc100->dirty_y2 = max(ftlcdc100->dirty_y2, y + height - 1);
+	spin_unlock_irqrestore(&ftlcdc100->damage_lock, flags);
 
-	return 0;
+	schedule_delayed_work(&info->deferred_work, ftlcdc100->fbdefio.delay);
 }
 
+/*
+ * Ordered dither for converting XRGB8888 to RGB565.  Each entry is the bias
+ * added to red, green and blue before they are cut to 5, 6 and 5 bits: a
+ * 4x4 Bayer matrix scaled to the 3, 2 and 3 bits dropped.
+ */
+#define FTLCDC100_DITHER(m)	((((m) >> 1) << 16) | (((m) >> 2) << 8) \
+				 | ((m) >> 1))
+
+static const u32 ftlcdc100_dither[4][4] = {
+	{ FTLCDC100_DITHER(0),  FTLCDC100_DITHER(8),
+	  FTLCDC100_DITHER(2),  FTLCDC100_DITHER(10) },
+	{ FTLCDC100_DITHER(12), FTLCDC100_DITHER(4),
+	  FTLCDC100_DITHER(14), FTLCDC100_DITHER(6) },
+	{ FTLCDC100_DITHER(3),  FTLCDC100_DITHER(11),
+	  FTLCDC100_DITHER(1),  FTLCDC100_DITHER(9) },
+	{ FTLCDC100_DITHER(15), FTLCDC100_DITHER(7),
+	  FTLCDC100_DITHER(13), FTLCDC100_DITHER(5) },
+};
+
 /**
- * ftlcdc100_set_par - Alters the hardware state.
+ * ftlcdc100_dither_pixel - Convert one XRGB8888 pixel to RGB565.
+ * @pixel: XRGB8888 pixel
+ * @bias: entry of ftlcdc100_dither
+ *
+ * The three channels are biased in one add, saturating at 0xff.  The bias
+ * is below 0x80, so no carry crosses a channel in the low 7 bits; a
+ * channel overflows if its top bit was set and the low bits carried into
+ * it.
+ */
+static u32 ftlcdc100_dither_pixel(u32 pixel, u32 bias)
+{
+	u32 sum = (pixel & 0x7f7f7f) + bias;
+	u32 carry = pixel & sum & 0x808080;
+
+	sum ^= pixel & 0x808080;
+	sum |= (carry >> 7) * 0xff;
+
+	return ((sum >> 8) & 0xf800) | ((sum >> 5) & 0x07e0)
+	     | ((sum >> 3) & 0x001f);
+}
+
+/**
+ * ftlcdc100_convert_line - Convert a line from XRGB8888 to dithered RGB565.
+ * @dst: vram line, 32-bit aligned
+ * @src: shadow buffer line
+ * @width: pixels, a multiple of 4
+ * @y: line number, for the dither pattern
+ *
+ * Four pixels per round, written as two words so the write buffer sees
+ * whole words of vram.
+ */
+static void ftlcdc100_convert_line(u32 *dst, const u32 *src,
+	unsigned int width, unsigned int y)
+{
+	const u32 *bias = ftlcdc100_dither[y & 3];
+
+	for (; width >= 4; width -= 4) {
+		dst[0] = ftlcdc100_dither_pixel(src[0], bias[0])
+		       | ftlcdc100_dither_pixel(src[1], bias[1]) << 16;
+		dst[1] = ftlcdc100_dither_pixel(src[2], bias[2])
+		       | ftlcdc100_dither_pixel(src[3], bias[3]) << 16;
+		src += 4;
+		dst += 2;
+	}
+}
+
+/**
+ * ftlcdc100_flush_damage - Bring the dirty lines of vram up to date.
  * @info: frame buffer structure that represents a single frame buffer
  *
- * Using the fb_var_screeninfo in fb_info we set the resolution of the
- * this particular framebuffer. This function alters the par AND the
- * fb_fix_screeninfo stored in fb_info. It does not alter var in 
- * fb_info since we are using that data. This means we depend on the
- * data in var inside fb_info to be supported by the hardware. 
+ * Copies the dirty lines of the shadow buffer to vram, or converts them in
+ * a converted mode.  Must be called from process context.
+ */
+static void ftlcdc100_flush_damage(struct fb_info *info)
+{
+	struct ftlcdc100 *ftlcdc100 = info->par;
+	unsigned int line_length = info->fix.line_length;
+	unsigned int vram_line_length = ftlcdc100_vram_line_length(info);
+	unsigned int lines = info->fix.smem_len / line_length;
+	unsigned long flags;
+	unsigned int y1;
+	unsigned int y2;
+	unsigned int y;
+
+	mutex_lock(&ftlcdc100->flush_lock);
+
+	spin_lock_irqsave(&ftlcdc100->damage_lock, flags);
+	y1 = ftlcdc100->dirty_y1;
+	y2 = ftlcdc100->dirty_y2;
+	ftlcdc100->dirty_y1 = ~0;
+	ftlcdc100->dirty_y2 = 0;
+	spin_unlock_irqrestore(&ftlcdc100->damage_lock, flags);
+
+	if (y2 >= lines)
+		y2 = lines - 1;
+
+	if (y1 > y2)
+		goto out;
+
+	if (!ftlcdc100_converting(ftlcdc100, &info->var)) {
+		memcpy(ftlcdc100->vram + y1 * line_length,
+			ftlcdc100->shadow + y1 * line_length,
+			(y2 - y1 + 1) * line_length);
+		goto out;
+	}
+
+	for (y = y1; y <= y2; y++)
+		ftlcdc100_convert_line(ftlcdc100->vram + y * vram_line_length,
+			ftlcdc100->shadow + y * line_length,
+			info->var.xres, y);
+
+out:
+	mutex_unlock(&ftlcdc100->flush_lock);
+}
+
+/**
+ * ftlcdc100_deferred_io - Flush dirty lines of the shadow buffer to vram.
+ * @info: frame buffer structure that represents a single frame buffer
+ * @pagelist: shadow buffer pages written through mmap since the last run
  *
- * This function is also used to recover/restore the hardware to a
- * known working state.
+ * Called from the deferred I/O worker.  Pages written through mmap are
+ * merged with the lines damaged by drawing functions and by
+ * FTLCDC100IOC_DAMAGE, and only that range of lines is flushed.
+ */
+static void ftlcdc100_deferred_io(struct fb_info *info,
+	struct list_head *pagelist)
+{
+	unsigned int line_length = info->fix.line_length;
+	unsigned long offset;
+	struct page *page;
+
+	list_for_each_entry(page, pagelist, lru) {
+		offset = page->index << PAGE_SHIFT;
+		ftlcdc100_damage(info, offset / line_length,
+			(offset + PAGE_SIZE - 1) / line_length
+			- offset / line_length + 1);
+	}
+
+	ftlcdc100_flush_damage(info);
+}
+
+/**
+ * ftlcdc100_palette_entry - Convert a color to a hardware palette entry.
+ * @info: frame buffer structure that represents a single frame buffer
+ * @red: The red value which can be up to 16 bits wide
+ * @green: The green value which can be up to 16 bits wide
+ * @blue: The blue value which can be up to 16 bits wide
+ */
+static u16 ftlcdc100_palette_entry(struct fb_info *info, unsigned red,
+	unsigned green, unsigned blue)
+{
+	if (info->var.grayscale) {
+		/* grayscale = 0.30*R + 0.59*G + 0.11*B */
+		red = green = blue = (red * 77 + green * 151 + blue * 28) >> 8;
+	}
+
+	return FTLCDC100_PALETTE_R(red >> 11)
+	     | FTLCDC100_PALETTE_G(green >> 11)
+	     | FTLCDC100_PALETTE_B(blue >> 11);
+}
+
+/**
+ * ftlcdc100_write_palette - Write palette entries to the hardware.
+ * @ftlcdc100: driver private data
+ * @first: first entry to write
+ * @last: last entry to write
  *
- * fb_check_var is always called before fb_set_par to ensure that
- * the contents of var is always valid.
+ * Entries first..last of ftlcdc100->palette are written, together with the
+ * other half of the first and last word.
+ */
+static void ftlcdc100_write_palette(struct ftlcdc100 *ftlcdc100,
+	unsigned int first, unsigned int last)
+{
+	unsigned int i;
+	u32 val;
+
+	for (i = first & ~1; i <= last; i += 2) {
+		val = ftlcdc100->palette[i] | (ftlcdc100->palette[i + 1] << 16);
+		iowrite32(val, ftlcdc100->base + FTLCDC100_OFFSET_PALETTE
+				+ i * 2);
+	}
+}
+
+/*
+ * Bus model used to admit modes.  The AHB moves at most one 32 bit word per
+ * bus clock.  The controller asks for more data when FTLCDC100_FIFO_SLACK
+ * bytes are left in its FIFO, and may then have to wait up to
+ * FTLCDC100_BUS_LATENCY bus clocks, e.g. for another master's 16 beat
+ * burst plus arbitration and an SDRAM row change.  The FIFO must keep the
+ * panel fed meanwhile.
+ */
+#define FTLCDC100_BUS_WIDTH	4
+#define FTLCDC100_FIFO_SLACK	32
+#define FTLCDC100_BUS_LATENCY	32
+
+struct ftlcdc100_bandwidth {
+	unsigned long peak;		/* kB/s fetched during active lines */
+	unsigned long average;		/* kB/s over the whole frame */
+	unsigned long max_pixclock;	/* kHz, fastest pixel clock that fits */
+	int headroom;			/* percent of the tighter limit left */
+};
+
+/**
+ * ftlcdc100_bandwidth - Estimate the memory bandwidth a mode needs.
+ * @var: mode
+ * @clk_value_khz: bus clock
+ * @bw: returns the estimate
  *
- * Again if you can't change the resolution you don't need this function.
+ * Two limits apply.  While a line is shown the FIFO drains at the peak
+ * rate, and must last through the bus latency.  Over the whole frame,
+ * including blanking, the average rate must stay within bus_share percent
+ * of what the bus can move.
+ */
+static void ftlcdc100_bandwidth(const struct fb_var_screeninfo *var,
+	unsigned long clk_value_khz, struct ftlcdc100_bandwidth *bw)
+{
+	unsigned int bits = max(var->bits_per_pixel, 1U);
+	unsigned long htotal = var->xres + var->left_margin
+			     + var->right_margin + var->hsync_len;
+	unsigned long vtotal = var->yres + var->upper_margin
+			     + var->lower_margin + var->vsync_len;
+	unsigned long active = var->xres * var->yres;
+	unsigned long peak_limit;
+	unsigned long budget;
+	unsigned long max_khz;
+	u64 tmp;
+
+	peak_limit = clk_value_khz * FTLCDC100_FIFO_SLACK
+		   / FTLCDC100_BUS_LATENCY;
+	budget = clk_value_khz * FTLCDC100_BUS_WIDTH / 100
+	       * min(bus_share, 100U);
+
+	bw->peak = DIV_ROUND_UP(PICOS2KHZ(var->pixclock) * bits, 8);
+
+	tmp = (u64)bw->peak * active;
+	do_div(tmp, htotal * vtotal);
+	bw->average = tmp;
+
+	/* the pixel clock at which either limit is reached */
+	bw->max_pixclock = peak_limit * 8 / bits;
+
+	tmp = (u64)budget * 8 * htotal * vtotal;
+	do_div(tmp, bits * active);
+	max_khz = min_t(u64, tmp, ULONG_MAX);
+	bw->max_pixclock = min(bw->max_pixclock, max_khz);
+
+	bw->headroom = 100 - max(bw->peak * 100 / max(peak_limit, 1UL),
+				 bw->average * 100 / max(budget, 1UL));
+}
+
+/*
+ * Largest pixel clock divider, bus clock / 64
+ */
+#define FTLCDC100_DIVNO_MAX	64
+
+/**
+ * ftlcdc100_solve_clock - Pick the pixel clock divider for a mode.
+ * @var: mode; pixclock and lower_margin are updated
+ * @clk_value_khz: rate of the bus clock the pixel clock is divided from
+ * @max_khz: fastest pixel clock the bus can feed
  *
- * However, even if your hardware does not support mode changing,
- * a set_par might be needed to at least initialize the hardware to
- * a known working state, especially if it came back from another
- * process that also modifies the same hardware, such as X.
+ * The pixel clock can only be the bus clock divided by 1..64, which is
+ * rarely the rate asked for.  Of the two nearest dividers, take the one
+ * that gives the refresh rate closest to the requested one after the
+ * vertical front porch has been stretched to make up for a faster clock.
+ * The porch is never shortened, as panels have a minimum.  On a tie the
+ * slower pixel clock wins, as it needs less bus bandwidth.
  *
- * Returns negative errno on error, or zero on success.
+ * Returns the divider, or negative errno if no divider is usable.
  */
-static int ftlcdc100_set_par(struct fb_info *info)
+static int ftlcdc100_solve_clock(struct fb_var_screeninfo *var,
+	unsigned long clk_value_khz, unsigned long max_khz)
 {
-	struct device *dev = info->device;
-	struct ftlcdc100 *ftlcdc100 = info->par;
-	unsigned long clk_value_khz = ftlcdc100->clk_value_khz;
+	unsigned long req_khz = PICOS2KHZ(var->pixclock);
+	unsigned int vtotal = var->yres + var->upper_margin
+			    + var->lower_margin + var->vsync_len;
+	unsigned int best_divno = 0;
+	unsigned int best_vtotal = 0;
+	unsigned long best_khz = 0;
+	u64 best_err = 0;
 	unsigned int divno;
-	unsigned int reg;
+	unsigned int vt;
+	unsigned long khz;
+	long lower;
+	u64 err;
 
-	dev_dbg(dev, "%s:\n", __func__);
-	dev_dbg(dev, "  resolution:     %ux%u (%ux%u virtual)\n",
-		info->var.xres, info->var.yres,
-		info->var.xres_virtual, info->var.yres_virtual);
+	if (req_khz == 0 || req_khz > clk_value_khz)
+		return -EINVAL;
 
-	/*
-	 * Fill uninitialized fields of struct fb_fix_screeninfo
-	 */
-	if (info->var.bits_per_pixel == 1)
-		info->fix.visual = FB_VISUAL_MONO01;
-	else if (info->var.bits_per_pixel <= 8)
-		info->fix.visual = FB_VISUAL_PSEUDOCOLOR;
-	else
-		info->fix.visual = FB_VISUAL_TRUECOLOR;
+	for (divno = DIV_ROUND_UP(clk_value_khz, req_khz);
+	     divno >= max(clk_value_khz / req_khz, 1UL); divno--) {
+		if (divno > FTLCDC100_DIVNO_MAX)
+			continue;
+
+		khz = DIV_ROUND_UP(clk_value_khz, divno);
+		if (khz > max_khz)
+			continue;
+
+		/* lines per frame for khz / vt == req_khz / vtotal */
+		lower = (long)var->lower_margin
+		      + DIV_ROUND_CLOSEST(khz * vtotal, req_khz) - vtotal;
+		lower = clamp(lower, (long)var->lower_margin, 255L);
+		vt = vtotal - var->lower_margin + lower;
+
+		/* refresh error, scaled by vtotal / req_khz */
+		err = abs((long)(khz * vtotal) - (long)(req_khz * vt));
+
+		if (best_divno == 0 || err * best_vtotal < best_err * vt) {
+			best_divno = divno;
+			best_vtotal = vt;
+			best_khz = khz;
+			best_err = err;
+		}
+	}
+
+	if (best_divno == 0)
+		return -EINVAL;
+
+	var->pixclock = KHZ2PICOS(best_khz);
+	var->lower_margin = best_vtotal - (vtotal - var->lower_margin);
+	return best_divno;
+}
 
-	info->fix.line_length = info->var.xres_virtual *
-				  DIV_ROUND_UP(info->var.bits_per_pixel, 8);
+/**
+ * ftlcdc100_compute_regs - Compute the timing and control registers for a mode.
+ * @var: mode, as accepted by ftlcdc100_check_var()
+ * @clk_value_khz: rate of the bus clock the pixel clock is divided from
+ * @regs: returns the register values and the pixel clock actually used
+ *
+ * This only does arithmetic; nothing is written to the hardware.
+ *
+ * Returns negative errno on error, or zero on success.
+ */
+static int ftlcdc100_compute_regs(const struct fb_var_screeninfo *var,
+	unsigned long clk_value_khz, struct ftlcdc100_regs *regs)
+{
+	unsigned int divno;
+	unsigned int reg;
 
 	/*
 	 * LCD clock and signal polarity control
 	 */
-	divno = DIV_ROUND_UP(clk_value_khz, PICOS2KHZ(info->var.pixclock));
-	if (divno == 0) {
-		dev_err(dev, "pixel clock(%lu kHz) > bus clock(%lu kHz)\n",
-			PICOS2KHZ(info->var.pixclock), clk_value_khz);
+	divno = DIV_ROUND_UP(clk_value_khz, PICOS2KHZ(var->pixclock));
+	if (divno == 0)
 		return -EINVAL;
-	}
 
-	clk_value_khz = DIV_ROUND_UP(clk_value_khz, divno);
-	info->var.pixclock = KHZ2PICOS(clk_value_khz);
-	dev_dbg(dev, "  updated pixclk: %lu KHz (divno = %x)\n",
-		clk_value_khz, divno - 1);
-
-	dev_dbg(dev, "  frame rate:     %lu Hz\n",
-		clk_value_khz * 1000
-		/ (info->var.xres + info->var.left_margin
-			+ info->var.right_margin + info->var.hsync_len)
-		/ (info->var.yres + info->var.upper_margin
-			+ info->var.lower_margin + info->var.vsync_len));
+	regs->pixclock = KHZ2PICOS(DIV_ROUND_UP(clk_value_khz, divno));
 
 	reg = FTLCDC100_LCD_CLOCK_POLARITY_DIVNO(divno - 1)
 	    | FTLCDC100_LCD_CLOCK_POLARITY_ADPEN;
 
-#ifdef CONFIG_FTLCDC100_LCD_CLOCK_POLARITY_ICK
-	reg |= FTLCDC100_LCD_CLOCK_POLARITY_ICK;
-#endif
+	if (var->sync & FTLCDC100_SYNC_ICK)
+		reg |= FTLCDC100_LCD_CLOCK_POLARITY_ICK;
 
-	if ((info->var.sync & FB_SYNC_HOR_HIGH_ACT) == 0)
+	if ((var->sync & FB_SYNC_HOR_HIGH_ACT) == 0)
 		reg |= FTLCDC100_LCD_CLOCK_POLARITY_IHS;
 
-	if ((info->var.sync & FB_SYNC_VERT_HIGH_ACT) == 0)
+	if ((var->sync & FB_SYNC_VERT_HIGH_ACT) == 0)
 		reg |= FTLCDC100_LCD_CLOCK_POLARITY_IVS;
 
-	dev_dbg(dev, "  [LCD CLOCK POLARITY] = %08x\n", reg);
-	iowrite32(reg, ftlcdc100->base + FTLCDC100_OFFSET_LCD_CLOCK_POLARITY);
+	regs->clock_polarity = reg;
+
+	/*
+	 * LCD horizontal timing control
+	 */
+	reg = FTLCDC100_LCD_HTIMING_PL(var->xres / 16 - 1);
+	reg |= FTLCDC100_LCD_HTIMING_HW(var->hsync_len - 1);
+	reg |= FTLCDC100_LCD_HTIMING_HFP(var->right_margin - 1);
+	reg |= FTLCDC100_LCD_HTIMING_HBP(var->left_margin - 1);
+
+	regs->htiming = reg;
+
+	/*
+	 * LCD vertical timing control
+	 */
+	reg = FTLCDC100_LCD_VTIMING_LF(var->yres - 1);
+	reg |= FTLCDC100_LCD_VTIMING_VW(var->vsync_len - 1);
+	reg |= FTLCDC100_LCD_VTIMING_VFP(var->lower_margin);
+	reg |= FTLCDC100_LCD_VTIMING_VBP(var->upper_margin);
+
+	regs->vtiming = reg;
+
+	/*
+	 * LCD Panel Pixel Parameters
+	 */
+	reg = FTLCDC100_LCD_CONTROL_ENABLE
+	    | FTLCDC100_LCD_CONTROL_TFT
+	    | FTLCDC100_LCD_CONTROL_BGR
+	    | FTLCDC100_LCD_CONTROL_LEB_LEP
+	    | FTLCDC100_LCD_CONTROL_LCD;
+
+	switch (var->bits_per_pixel) {
+		case 1:
+			reg |= FTLCDC100_LCD_CONTROL_BPP1;
+			break;
+
+		case 2:
+			reg |= FTLCDC100_LCD_CONTROL_BPP2;
+			break;
+
+		case 4:
+			reg |= FTLCDC100_LCD_CONTROL_BPP4;
+			break;
+
+		case 8:
+			reg |= FTLCDC100_LCD_CONTROL_BPP8;
+			break;
+
+		case 16:
+			reg |= FTLCDC100_LCD_CONTROL_BPP16;
+			break;
+
+		case 32:
+			reg |= FTLCDC100_LCD_CONTROL_BPP24;
+			break;
+
+		case 12:	/* YUV420 */
+			reg |= FTLCDC100_LCD_CONTROL_BPP16;
+			break;
+
+		default:
+			BUG();
+			break;
+	}
+
+	switch (var->nonstd) {
+		case FTLCDC100_NONSTD_YUV422:
+			reg |= FTLCDC100_LCD_CONTROL_YUV;
+			break;
+
+		case FTLCDC100_NONSTD_YUV420:
+			reg |= FTLCDC100_LCD_CONTROL_YUV
+			    |  FTLCDC100_LCD_CONTROL_YUV420;
+			break;
+	}
+
+	regs->control = reg;
+
+	return 0;
+}
+
+/**
+ * ftlcdc100_glyph_invalidate - Drop all entries of the glyph cache.
+ * @ftlcdc100: driver private data
+ */
+static void ftlcdc100_glyph_invalidate(struct ftlcdc100 *ftlcdc100)
+{
+	int i;
+
+	for (i = 0; i < FTLCDC100_GLYPH_CACHE_SLOTS; i++)
+		ftlcdc100->glyph_slot[i].valid = 0;
+}
+
+/**
+ * ftlcdc100_wait_for_vsync - Sleep until the next NEXT_BASE interrupt.
+ * @info: frame buffer structure that represents a single frame buffer
+ *
+ * The controller latches FRAME_BASE once per frame and raises NEXT_BASE when
+ * it has done so.  Any base written before this call is therefore in use by
+ * the time we return.
+ *
+ * Returns negative errno on error, or zero on success.
+ */
+static int ftlcdc100_wait_for_vsync(struct fb_info *info)
+{
+	struct ftlcdc100 *ftlcdc100 = info->par;
+	unsigned int count = ftlcdc100->vsync_count;
+	long ret;
+
+	ret = wait_event_interruptible_timeout(ftlcdc100->vsync_wait,
+			count != ftlcdc100->vsync_count, HZ / 10);
+	if (ret < 0)
+		return ret;
+
+	if (ret == 0)
+		return -ETIMEDOUT;
+
+	return 0;
+}
+
+/**
+ * ftlcdc100_ypanstep - Smallest pan step that keeps FRAME_BASE aligned.
+ * @line_length: bytes per line of vram
+ *
+ * At 1, 2 and 4bpp a line can be shorter than FTLCDC100_FRAME_BASE_ALIGN,
+ * or not a multiple of it.
+ */
+static unsigned int ftlcdc100_ypanstep(unsigned int line_length)
+{
+	/* largest power of two dividing line_length */
+	unsigned int align = line_length & -line_length;
+
+	if (align >= FTLCDC100_FRAME_BASE_ALIGN)
+		return 1;
+
+	return FTLCDC100_FRAME_BASE_ALIGN / align;
+}
+
+/**
+ * ftlcdc100_yoffset_to_base - Compute the FRAME_BASE value of a pan position.
+ * @info: frame buffer structure that represents a single frame buffer
+ * @yoffset: first line to display
+ * @reg: returned register value
+ *
+ * Returns negative errno on error, or zero on success.
+ */
+static int ftlcdc100_yoffset_to_base(struct fb_info *info,
+	unsigned int yoffset, unsigned int *reg)
+{
+	unsigned long dma_addr;
+
+	if (yoffset + info->var.yres > info->var.yres_virtual)
+		return -EINVAL;
+
+	if (info->var.nonstd == FTLCDC100_NONSTD_YUV420) {
+		/* whole frames only, each with its own U and V planes */
+		if (yoffset % info->var.yres)
+			return -EINVAL;
+
+		dma_addr = info->fix.smem_start + yoffset / info->var.yres
+			 * ftlcdc100_frame_size(&info->var);
+		*reg = FTLCDC100_LCD_FRAME_BASE(dma_addr)
+		     | ftlcdc100_frame420_size(&info->var);
+		return 0;
+	}
+
+	/* the controller would silently show a different line */
+	if (yoffset % info->fix.ypanstep)
+		return -EINVAL;
+
+	dma_addr = info->fix.smem_start
+		 + yoffset * ftlcdc100_vram_line_length(info);
+	*reg = FTLCDC100_LCD_FRAME_BASE(dma_addr);
+	return 0;
+}
+
+/**
+ * ftlcdc100_get_buffer - Describe one frame sized buffer of the virtual screen.
+ * @info: frame buffer structure that represents a single frame buffer
+ * @buffer: buffer index in, description out
+ *
+ * Returns negative errno on error, or zero on success.
+ */
+static int ftlcdc100_get_buffer(struct fb_info *info,
+	struct ftlcdc100_buffer *buffer)
+{
+	struct ftlcdc100 *ftlcdc100 = info->par;
+	unsigned int size = ftlcdc100_frame_size(&info->var);
+
+	/* the buffers clients draw into are in the shadow, not in vram */
+	if (ftlcdc100->defio)
+		return -EINVAL;
+
+	buffer->count = info->var.yres_virtual / info->var.yres;
+	if (buffer->index >= buffer->count)
+		return -EINVAL;
+
+	buffer->yoffset = buffer->index * info->var.yres;
+	buffer->offset = buffer->index * size;
+	buffer->phys = info->fix.smem_start + buffer->offset;
+	buffer->size = size;
+	buffer->line_length = info->fix.line_length;
+	return 0;
+}
+
+/**
+ * ftlcdc100_queue_frame_base - Queue a FRAME_BASE value for the next vblank.
+ * @ftlcdc100: driver private data
+ * @reg: value for FRAME_BASE
+ * @yoffset: yoffset reported in the flip status once it is on screen
+ * @sequence: returns the sequence number of the flip
+ *
+ * Returns negative errno on error, or zero on success.
+ */
+static int ftlcdc100_queue_frame_base(struct ftlcdc100 *ftlcdc100,
+	unsigned int reg, unsigned int yoffset, unsigned int *sequence)
+{
+	struct ftlcdc100_flip_entry *entry;
+	unsigned long flags;
+
+	spin_lock_irqsave(&ftlcdc100->flip_lock, flags);
+
+	/* the layout of the buffers changes with the staged mode */
+	if (ftlcdc100->flip_count == FTLCDC100_FLIP_QUEUE_LEN
+	 || ftlcdc100->commit_done != ftlcdc100->commit_queued) {
+		spin_unlock_irqrestore(&ftlcdc100->flip_lock, flags);
+		return -EBUSY;
+	}
+
+	entry = &ftlcdc100->flip_queue[(ftlcdc100->flip_head
+			+ ftlcdc100->flip_count) % FTLCDC100_FLIP_QUEUE_LEN];
+	entry->frame_base = reg;
+	entry->yoffset = yoffset;
+	entry->sequence = ++ftlcdc100->flip_queued;
+	ftlcdc100->flip_count++;
+
+	*sequence = entry->sequence;
+
+	spin_unlock_irqrestore(&ftlcdc100->flip_lock, flags);
+	return 0;
+}
+
+/**
+ * ftlcdc100_queue_flip - Queue a frame base for the next free vblank.
+ * @info: frame buffer structure that represents a single frame buffer
+ * @flip: yoffset to show; the assigned sequence number is returned in it
+ *
+ * Returns negative errno on error, or zero on success.
+ */
+static int ftlcdc100_queue_flip(struct fb_info *info,
+	struct ftlcdc100_flip *flip)
+{
+	struct ftlcdc100 *ftlcdc100 = info->par;
+	unsigned int reg;
+	int ret;
+
+	ret = ftlcdc100_yoffset_to_base(info, flip->yoffset, &reg);
+	if (ret)
+		return ret;
+
+	ret = ftlcdc100_queue_frame_base(ftlcdc100, reg, flip->yoffset,
+		&flip->sequence);
+	if (ret)
+		return ret;
+
+	info->var.yoffset = flip->yoffset;
+	return 0;
+}
+
+/**
+ * ftlcdc100_queue_phys_flip - Queue a buffer outside the frame buffer.
+ * @info: frame buffer structure that represents a single frame buffer
+ * @flip: bus address to show; the assigned sequence number is returned in it
+ *
+ * The buffer must hold a frame in the current mode, including the U and V
+ * planes in YUV420 mode.  The controller fetches from it until a later flip
+ * is on screen; keeping it allocated until then is up to the caller.
+ *
+ * Returns negative errno on error, or zero on success.
+ */
+static int ftlcdc100_queue_phys_flip(struct fb_info *info,
+	struct ftlcdc100_phys_flip *flip)
+{
+	struct ftlcdc100 *ftlcdc100 = info->par;
+	unsigned int reg;
+
+	if (FTLCDC100_LCD_FRAME_BASE(flip->phys) != flip->phys)
+		return -EINVAL;
+
+	reg = flip->phys;
+	if (info->var.nonstd == FTLCDC100_NONSTD_YUV420)
+		reg |= ftlcdc100_frame420_size(&info->var);
+
+	return ftlcdc100_queue_frame_base(ftlcdc100, reg,
+		FTLCDC100_FLIP_EXTERNAL, &flip->sequence);
+}
+
+/**
+ * ftlcdc100_flip_done - Return true once flip @sequence is on screen.
+ * @ftlcdc100: driver private data
+ * @sequence: sequence number returned by FTLCDC100IOC_QUEUE_FLIP
+ */
+static int ftlcdc100_flip_done(struct ftlcdc100 *ftlcdc100,
+	unsigned int sequence)
+{
+	return (int)(ftlcdc100->flip_displayed - sequence) >= 0;
+}
+
+/**
+ * ftlcdc100_flip_pending - Return the number of flips not yet on screen.
+ * @ftlcdc100: driver private data
+ */
+static unsigned int ftlcdc100_flip_pending(struct ftlcdc100 *ftlcdc100)
+{
+	unsigned long flags;
+	unsigned int pending;
+
+	spin_lock_irqsave(&ftlcdc100->flip_lock, flags);
+	pending = ftlcdc100->flip_count + ftlcdc100->flip_latched;
+	spin_unlock_irqrestore(&ftlcdc100->flip_lock, flags);
+
+	return pending;
+}
+
+/**
+ * ftlcdc100_control - Value of CONTROL for a mode.
+ * @ftlcdc100: driver private data
+ * @control: CONTROL as computed for the mode
+ *
+ * Once underruns made us switch the FIFO threshold it is kept across
+ * modes.  Called with flip_lock held, so that a switch made between
+ * staging and programming a mode is not lost.
+ */
+static unsigned int ftlcdc100_control(struct ftlcdc100 *ftlcdc100,
+	unsigned int control)
+{
+	if (ftlcdc100->fifo_threshold)
+		control |= FTLCDC100_LCD_CONTROL_FIFO_THRESHOLD;
+
+	return control;
+}
+
+/**
+ * ftlcdc100_commit_regs - Program the staged register set.
+ * @ftlcdc100: driver private data
+ *
+ * Called with flip_lock held, from the interrupt handler at vblank or
+ * directly while the LCD is off.  Flips queued for the old layout are
+ * dropped; like a pan, the new frame base has a flip sequence number of
+ * its own, commit_flip, taken when the set was staged.
+ */
+static void ftlcdc100_commit_regs(struct ftlcdc100 *ftlcdc100)
+{
+	struct ftlcdc100_regs *regs = &ftlcdc100->commit_regs;
+
+	ftlcdc100_update_reg(ftlcdc100, FTLCDC100_OFFSET_LCD_CLOCK_POLARITY,
+		regs->clock_polarity);
+	ftlcdc100_update_reg(ftlcdc100, FTLCDC100_OFFSET_LCD_HTIMING,
+		regs->htiming);
+	ftlcdc100_update_reg(ftlcdc100, FTLCDC100_OFFSET_LCD_VTIMING,
+		regs->vtiming);
+	ftlcdc100_write_reg(ftlcdc100, FTLCDC100_OFFSET_LCD_FRAME_BASE,
+		regs->frame_base);
+	ftlcdc100_update_reg(ftlcdc100, FTLCDC100_OFFSET_LCD_CONTROL,
+		ftlcdc100_control(ftlcdc100, regs->control));
+
+	ftlcdc100->flip_count = 0;
+	ftlcdc100->flip_latch.frame_base = regs->frame_base;
+	ftlcdc100->flip_latch.yoffset = ftlcdc100->commit_yoffset;
+	ftlcdc100->flip_latch.sequence = ftlcdc100->commit_flip;
+	ftlcdc100->flip_latched = 1;
+
+	ftlcdc100->commit_done = ftlcdc100->commit_queued;
+}
+
+/**
+ * ftlcdc100_commit_done - Return true once commit @sequence is programmed.
+ * @ftlcdc100: driver private data
+ * @sequence: value of commit_queued after staging
+ */
+static int ftlcdc100_commit_done(struct ftlcdc100 *ftlcdc100,
+	unsigned int sequence)
+{
+	return (int)(ftlcdc100->commit_done - sequence) >= 0;
+}
+
+/**
+ * ftlcdc100_flip_work - Notify sysfs pollers that a buffer was retired.
+ * @work: flip_work in struct ftlcdc100
+ */
+static void ftlcdc100_flip_work(struct work_struct *work)
+{
+	struct ftlcdc100 *ftlcdc100 = container_of(work, struct ftlcdc100,
+						   flip_work);
+	struct fb_info *info = ftlcdc100->info;
+
+	/* flips can complete before the frame buffer is registered */
+	if (info->dev)
+		sysfs_notify(&info->dev->kobj, NULL, "flip_displayed");
+}
+
+/**
+ * ftlcdc100_underrun_work - Report an underrun recovery step.
+ * @work: underrun_work in struct ftlcdc100
+ *
+ * Once the FIFO threshold has been switched there is nothing left the
+ * driver can do by itself, so userspace is told, through a change uevent
+ * and the underrun_advice attribute, to pick a slower pixel clock or a
+ * smaller depth.
+ */
+static void ftlcdc100_underrun_work(struct work_struct *work)
+{
+	struct ftlcdc100 *ftlcdc100 = container_of(work, struct ftlcdc100,
+						   underrun_work);
+	struct fb_info *info = ftlcdc100->info;
+	static char *envp[] = { "FTLCDC100_UNDERRUN=reduce_bandwidth", NULL };
+
+	if (!ftlcdc100->underrun_advice) {
+		dev_info(info->device, "underruns, fetching earlier\n");
+		return;
+	}
+
+	dev_warn(info->device, "underruns persist, lower the pixel clock "
+		"or the color depth\n");
+
+	/* before registration, underrun_advice is read once it appears */
+	if (!info->dev)
+		return;
+
+	sysfs_notify(&info->dev->kobj, NULL, "underrun_advice");
+	kobject_uevent_env(&info->dev->kobj, KOBJ_CHANGE, envp);
+}
+
+/**
+ * ftlcdc100_underrun_check - Account one frame for underrun recovery.
+ * @ftlcdc100: driver private data
+ *
+ * Called from the interrupt handler once per frame.
+ */
+static void ftlcdc100_underrun_check(struct ftlcdc100 *ftlcdc100)
+{
+	unsigned int control;
+
+	if (++ftlcdc100->underrun_frames < FTLCDC100_UNDERRUN_WINDOW)
+		return;
+
+	if (ftlcdc100->underrun_count >= FTLCDC100_UNDERRUN_LIMIT) {
+		if (!ftlcdc100->fifo_threshold) {
+			spin_lock(&ftlcdc100->flip_lock);
+			ftlcdc100->fifo_threshold = 1;
+			control = ftlcdc100_read_reg(ftlcdc100,
+					FTLCDC100_OFFSET_LCD_CONTROL);
+			ftlcdc100_write_reg(ftlcdc100,
+				FTLCDC100_OFFSET_LCD_CONTROL,
+				ftlcdc100_control(ftlcdc100, control));
+			spin_unlock(&ftlcdc100->flip_lock);
+			schedule_work(&ftlcdc100->underrun_work);
+		} else if (!ftlcdc100->underrun_advice) {
+			ftlcdc100->underrun_advice = 1;
+			schedule_work(&ftlcdc100->underrun_work);
+		}
+	}
+
+	ftlcdc100->underrun_frames = 0;
+	ftlcdc100->underrun_count = 0;
+}
+
+/**
+ * ftlcdc100_stats_work - Report interrupt errors outside of IRQ context.
+ * @work: stats_work in struct ftlcdc100
+ */
+static void ftlcdc100_stats_work(struct work_struct *work)
+{
+	struct ftlcdc100 *ftlcdc100 = container_of(work, struct ftlcdc100,
+						   stats_work);
+	struct fb_info *info = ftlcdc100->info;
+	unsigned long bus_error;
+	unsigned long flags;
+
+	spin_lock_irqsave(&ftlcdc100->stats_lock, flags);
+	bus_error = ftlcdc100->stats.bus_error;
+	spin_unlock_irqrestore(&ftlcdc100->stats_lock, flags);
+
+	if (bus_error != ftlcdc100->bus_error_reported && printk_ratelimit()) {
+		dev_err(info->device, "%lu bus errors\n",
+			bus_error - ftlcdc100->bus_error_reported);
+		ftlcdc100->bus_error_reported = bus_error;
+	}
+
+	/* errors can be raised before the frame buffer is registered */
+	if (info->dev)
+		sysfs_notify(&info->dev->kobj, NULL, "irq_stats");
+}
+
+/**
+ * ftlcdc100_account_irq - Count an interrupt in the statistics.
+ * @ftlcdc100: driver private data
+ * @status: INT_STATUS
+ *
+ * Called from the interrupt handler.
+ */
+static void ftlcdc100_account_irq(struct ftlcdc100 *ftlcdc100,
+	unsigned int status)
+{
+	spin_lock(&ftlcdc100->stats_lock);
+
+	if (status & FTLCDC100_LCD_INT_UNDERRUN)
+		ftlcdc100->stats.underrun++;
+
+	if (status & FTLCDC100_LCD_INT_NEXT_BASE) {
+		ftlcdc100->stats.next_base++;
+		ftlcdc100->vblank_time[ftlcdc100->vblank_head] = ktime_get();
+		ftlcdc100->vblank_head = (ftlcdc100->vblank_head + 1)
+				       % FTLCDC100_VBLANK_RING;
+	}
+
+	if (status & FTLCDC100_LCD_INT_VSTATUS)
+		ftlcdc100->stats.vstatus++;
+
+	if (status & FTLCDC100_LCD_INT_BUS_ERROR)
+		ftlcdc100->stats.bus_error++;
+
+	spin_unlock(&ftlcdc100->stats_lock);
+
+	if (status & (FTLCDC100_LCD_INT_UNDERRUN | FTLCDC100_LCD_INT_BUS_ERROR))
+		schedule_work(&ftlcdc100->stats_work);
+}
+
+/******************************************************************************
+ * interrupt handler
+ *****************************************************************************/
+static irqreturn_t ftlcdc100_interrupt(int irq, void *dev_id)
+{
+	struct fb_info *info = dev_id;
+	struct ftlcdc100 *ftlcdc100 = info->par;
+	unsigned int status;
+
+	status = ioread32(ftlcdc100->base + FTLCDC100_OFFSET_LCD_INT_STATUS);
+
+	ftlcdc100_account_irq(ftlcdc100, status);
+
+	if (status & FTLCDC100_LCD_INT_UNDERRUN)
+		ftlcdc100->underrun_count++;
+
+	if (status & FTLCDC100_LCD_INT_NEXT_BASE) {
+		struct ftlcdc100_flip_entry *entry;
+		int retired = 0;
+
+		spin_lock(&ftlcdc100->flip_lock);
+
+		/* the base written at the last vblank is on screen now */
+		if (ftlcdc100->flip_latched) {
+			ftlcdc100->flip_displayed = ftlcdc100->flip_latch.sequence;
+			ftlcdc100->flip_yoffset = ftlcdc100->flip_latch.yoffset;
+			ftlcdc100->flip_latched = 0;
+			retired = 1;
+		}
+
+		if (ftlcdc100->commit_done != ftlcdc100->commit_queued) {
+			ftlcdc100_commit_regs(ftlcdc100);
+		} else if (ftlcdc100->flip_count) {
+			entry = &ftlcdc100->flip_queue[ftlcdc100->flip_head];
+			ftlcdc100_write_reg(ftlcdc100,
+				FTLCDC100_OFFSET_LCD_FRAME_BASE,
+				entry->frame_base);
+
+			ftlcdc100->flip_latch = *entry;
+			ftlcdc100->flip_latched = 1;
+			ftlcdc100->flip_head = (ftlcdc100->flip_head + 1)
+					     % FTLCDC100_FLIP_QUEUE_LEN;
+			ftlcdc100->flip_count--;
+		}
+
+		spin_unlock(&ftlcdc100->flip_lock);
+
+		ftlcdc100->vsync_count++;
+		wake_up_interruptible(&ftlcdc100->vsync_wait);
+
+		ftlcdc100_underrun_check(ftlcdc100);
+
+		if (retired)
+			schedule_work(&ftlcdc100->flip_work);
+	}
+
+	iowrite32(status, ftlcdc100->base + FTLCDC100_OFFSET_LCD_INT_CLEAR);
+
+	return IRQ_HANDLED;
+}
+
+/******************************************************************************
+ * struct fb_ops functions
+ *****************************************************************************/
+/**
+ * ftlcdc100_open - Optional function. Called when the framebuffer is opened.
+ * @info: frame buffer structure that represents a single frame buffer
+ * @user: tell us if the userland (value=1) or the console is accessing
+ *	  the framebuffer
+ *
+ * Userspace must never see memory that has not been cleared yet, so wait
+ * for the fast boot clearing to finish.
+ *
+ * Returns negative errno on error, or zero on success.
+ */
+static int ftlcdc100_open(struct fb_info *info, int user)
+{
+	struct ftlcdc100 *ftlcdc100 = info->par;
+
+	if (user && ftlcdc100->fastboot)
+		flush_work(&ftlcdc100->zero_work);
+
+	return 0;
+}
+
+/**
+ * ftlcdc100_check_var - Validates a var passed in.
+ * @var: frame buffer variable screen structure
+ * @info: frame buffer structure that represents a single frame buffer 
+ *
+ * Checks to see if the hardware supports the state requested by
+ * var passed in. This function does not alter the hardware state!!! 
+ * This means the data stored in struct fb_info and struct ftlcdc100 do 
+ * not change. This includes the var inside of struct fb_info. 
+ * Do NOT change these. This function can be called on its own if we
+ * intent to only test a mode and not actually set it. The stuff in 
+ * modedb.c is a example of this. If the var passed in is slightly 
+ * off by what the hardware can support then we alter the var PASSED in
+ * to what we can do.
+ *
+ * For values that are off, this function must round them _up_ to the
+ * next value that is supported by the hardware.  If the value is
+ * greater than the highest value supported by the hardware, then this
+ * function must return -EINVAL.
+ *
+ * Exception to the above rule:  Some drivers have a fixed mode, ie,
+ * the hardware is already set at boot up, and cannot be changed.  In
+ * this case, it is more acceptable that this function just return
+ * a copy of the currently working var (info->var). Better is to not
+ * implement this function, as the upper layer will do the copying
+ * of the current var for you.
+ *
+ * Note:  This is the only function where the contents of var can be
+ * freely adjusted after the driver has been registered. If you find
+ * that you have code outside of this function that alters the content
+ * of var, then you are doing something wrong.  Note also that the
+ * contents of info->var must be left untouched at all times after
+ * driver registration.
+ *
+ * Returns negative errno on error, or zero on success.
+ */
+static int ftlcdc100_check_var(struct fb_var_screeninfo *var,
+		struct fb_info *info)
+{
+	struct device *dev = info->device;
+	struct ftlcdc100 *ftlcdc100 = info->par;
+	unsigned long clk_value_khz = ftlcdc100->clk_value_khz;
+	struct fb_var_screeninfo scanout;
+	struct ftlcdc100_bandwidth bw;
+	int ret;
+
+	dev_dbg(dev, "%s:\n", __func__);
+
+	if (var->pixclock == 0) {
+		dev_err(dev, "pixclock not specified\n");
+		return -EINVAL;
+	}
+
+	dev_dbg(dev, "  resolution: %ux%u (%ux%u virtual)\n",
+		var->xres, var->yres,
+		var->xres_virtual, var->yres_virtual);
+	dev_dbg(dev, "  pixclk:       %lu KHz\n", PICOS2KHZ(var->pixclock));
+	dev_dbg(dev, "  bpp:          %u\n", var->bits_per_pixel);
+	dev_dbg(dev, "  clk:          %lu KHz\n", clk_value_khz);
+	dev_dbg(dev, "  left  margin: %u\n", var->left_margin);
+	dev_dbg(dev, "  right margin: %u\n", var->right_margin);
+	dev_dbg(dev, "  upper margin: %u\n", var->upper_margin);
+	dev_dbg(dev, "  lower margin: %u\n", var->lower_margin);
+	dev_dbg(dev, "  hsync:        %u\n", var->hsync_len);
+	dev_dbg(dev, "  vsync:        %u\n", var->vsync_len);
+
+	/*
+	 * The field widths of HTIMING and VTIMING limit the timings
+	 */
+	if (var->xres == 0 || var->xres % 16 || var->xres > 1024
+	 || var->yres == 0 || var->yres > 1024) {
+		dev_dbg(dev, "%ux%u not supported\n", var->xres, var->yres);
+		return -EINVAL;
+	}
+
+	if (var->hsync_len < 1 || var->hsync_len > 256
+	 || var->right_margin < 1 || var->right_margin > 256
+	 || var->left_margin < 1 || var->left_margin > 256
+	 || var->vsync_len < 1 || var->vsync_len > 64
+	 || var->lower_margin > 255 || var->upper_margin > 255) {
+		dev_dbg(dev, "sync or margins out of range\n");
+		return -EINVAL;
+	}
+
+	/* no horizontal panning */
+	var->xres_virtual = var->xres;
+	var->xoffset = 0;
+
+	if (var->yres_virtual < var->yres)
+		var->yres_virtual = var->yres;
+
+	switch (var->nonstd) {
+	case 0:
+		break;
+
+	case FTLCDC100_NONSTD_YUV422:
+		var->bits_per_pixel = 16;
+		break;
+
+	case FTLCDC100_NONSTD_YUV420:
+		if (ftlcdc100_frame420_size(var) < 0) {
+			dev_err(dev, "YUV420 not supported at %ux%u\n",
+				var->xres, var->yres);
+			return -EINVAL;
+		}
+
+		/* frames are panned as a whole */
+		var->yres_virtual = roundup(var->yres_virtual, var->yres);
+		var->bits_per_pixel = 12;
+		break;
+
+	default:
+		dev_err(dev, "nonstd mode %u not supported\n", var->nonstd);
+		return -EINVAL;
+	}
+
+	/*
+	 * Slow the pixel clock down if the bus cannot feed it
+	 */
+	ftlcdc100_bandwidth(ftlcdc100_scanout_var(ftlcdc100, var, &scanout),
+		clk_value_khz, &bw);
+	dev_dbg(dev, "  bandwidth:    %lu kB/s peak, %lu kB/s average\n",
+		bw.peak, bw.average);
+
+	if (PICOS2KHZ(var->pixclock) > bw.max_pixclock) {
+		if (bw.max_pixclock == 0) {
+			dev_err(dev, "bus too slow for %ux%u-%u\n",
+				var->xres, var->yres, var->bits_per_pixel);
+			return -EINVAL;
+		}
+
+		dev_info(dev, "pixel clock lowered from %lu to %lu KHz "
+			"to fit bus bandwidth\n", PICOS2KHZ(var->pixclock),
+			bw.max_pixclock);
+		var->pixclock = KHZ2PICOS(bw.max_pixclock);
+	}
+
+	ret = ftlcdc100_solve_clock(var, clk_value_khz, bw.max_pixclock);
+	if (ret < 0) {
+		dev_err(dev, "%lu KHz pixel clock not possible with %lu KHz "
+			"bus clock\n", PICOS2KHZ(var->pixclock), clk_value_khz);
+		return ret;
+	}
+
+	dev_dbg(dev, "  solved pixclk: %lu KHz (divno = %d), lower margin %u\n",
+		PICOS2KHZ(var->pixclock), ret, var->lower_margin);
+
+	/* while probe chooses the initial mode, the pool is not reserved yet */
+	if (ftlcdc100->vram && ftlcdc100_buffer_size(var) > info->fix.smem_len) {
+		dev_err(dev, "mode needs more than the %u bytes reserved\n",
+			info->fix.smem_len);
+		return -ENOMEM;
+	}
+
+	if (var->nonstd) {
+		/* no RGB layout in YUV modes */
+		memset(&var->red, 0, sizeof(var->red));
+		memset(&var->green, 0, sizeof(var->green));
+		memset(&var->blue, 0, sizeof(var->blue));
+		memset(&var->transp, 0, sizeof(var->transp));
+		return 0;
+	}
+
+	switch (var->bits_per_pixel) {
+	case 1: case 2: case 4: case 8:
+		var->red.offset = var->green.offset = var->blue.offset = 0;
+		var->red.length = var->green.length = var->blue.length
+			= var->bits_per_pixel;
+		break;
+
+	case 16:	/* RGB:565 mode */
+		var->red.offset		= 11;
+		var->green.offset	= 5;
+		var->blue.offset	= 0;
+
+		var->red.length		= 5;
+		var->green.length	= 6;
+		var->blue.length	= 5;
+		var->transp.length	= 0;
+		break;
+
+	case 32:	/* RGB:888 mode */
+		var->red.offset		= 16;
+		var->green.offset	= 8;
+		var->blue.offset	= 0;
+		var->transp.offset	= 24;
+
+		var->red.length = var->green.length = var->blue.length = 8;
+		var->transp.length	= 8;
+		break;
+
+	default:
+		dev_err(dev, "color depth %d not supported\n",
+					var->bits_per_pixel);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+/**
+ * ftlcdc100_set_par - Alters the hardware state.
+ * @info: frame buffer structure that represents a single frame buffer
+ *
+ * Using the fb_var_screeninfo in fb_info we set the resolution of the
+ * this particular framebuffer. This function alters the par AND the
+ * fb_fix_screeninfo stored in fb_info. It does not alter var in 
+ * fb_info since we are using that data. This means we depend on the
+ * data in var inside fb_info to be supported by the hardware. 
+ *
+ * This function is also used to recover/restore the hardware to a
+ * known working state.
+ *
+ * fb_check_var is always called before fb_set_par to ensure that
+ * the contents of var is always valid.
+ *
+ * Again if you can't change the resolution you don't need this function.
+ *
+ * However, even if your hardware does not support mode changing,
+ * a set_par might be needed to at least initialize the hardware to
+ * a known working state, especially if it came back from another
+ * process that also modifies the same hardware, such as X.
+ *
+ * Returns negative errno on error, or zero on success.
+ */
+static int ftlcdc100_set_par(struct fb_info *info)
+{
+	struct device *dev = info->device;
+	struct ftlcdc100 *ftlcdc100 = info->par;
+	unsigned long clk_value_khz = ftlcdc100->clk_value_khz;
+	struct fb_var_screeninfo scanout;
+	struct ftlcdc100_regs regs;
+	unsigned int sequence;
+	unsigned long flags;
+	int running;
+	int ret;
+
+	dev_dbg(dev, "%s:\n", __func__);
+
+	ftlcdc100_glyph_invalidate(ftlcdc100);
+
+	dev_dbg(dev, "  resolution:     %ux%u (%ux%u virtual)\n",
+		info->var.xres, info->var.yres,
+		info->var.xres_virtual, info->var.yres_virtual);
+
+	/*
+	 * Fill uninitialized fields of struct fb_fix_screeninfo
+	 */
+	if (info->var.bits_per_pixel <= 8) {
+		/* 1bpp also goes through the palette */
+		info->fix.visual = FB_VISUAL_PSEUDOCOLOR;
+		ftlcdc100_write_palette(ftlcdc100, 0,
+			FTLCDC100_PALETTE_ENTRIES - 1);
+	} else {
+		info->fix.visual = FB_VISUAL_TRUECOLOR;
+	}
+
+	info->fix.line_length = ftlcdc100_line_length(&info->var);
+
+	if (info->var.nonstd == FTLCDC100_NONSTD_YUV420)
+		info->fix.ypanstep = info->var.yres;
+	else
+		info->fix.ypanstep = ftlcdc100_ypanstep(
+					ftlcdc100_vram_line_length(info));
+
+	ret = ftlcdc100_compute_regs(ftlcdc100_scanout_var(ftlcdc100,
+			&info->var, &scanout), clk_value_khz, &regs);
+	if (ret) {
+		dev_err(dev, "pixel clock(%lu kHz) > bus clock(%lu kHz)\n",
+			PICOS2KHZ(info->var.pixclock), clk_value_khz);
+		return ret;
+	}
+
+	info->var.pixclock = regs.pixclock;
+	dev_dbg(dev, "  updated pixclk: %lu KHz\n", PICOS2KHZ(regs.pixclock));
+
+	dev_dbg(dev, "  frame rate:     %lu Hz\n",
+		PICOS2KHZ(regs.pixclock) * 1000
+		/ (info->var.xres + info->var.left_margin
+			+ info->var.right_margin + info->var.hsync_len)
+		/ (info->var.yres + info->var.upper_margin
+			+ info->var.lower_margin + info->var.vsync_len));
+
+	/* a new mode deserves a new chance */
+	ftlcdc100->underrun_advice = 0;
+
+	/*
+	 * LCD panel frame base
+	 * The layout of the frame may have changed (e.g. YUV420 frame size).
+	 */
+	if (ftlcdc100_yoffset_to_base(info, info->var.yoffset,
+			&regs.frame_base)) {
+		info->var.yoffset = 0;
+		ftlcdc100_yoffset_to_base(info, 0, &regs.frame_base);
+	}
+
+	dev_dbg(dev, "  [LCD CLOCK POLARITY] = %08x\n", regs.clock_polarity);
+	dev_dbg(dev, "  [LCD HTIMING] = %08x\n", regs.htiming);
+	dev_dbg(dev, "  [LCD VTIMING] = %08x\n", regs.vtiming);
+	dev_dbg(dev, "  [LCD CONTROL] = %08x\n", regs.control);
+	dev_dbg(dev, "  [LCD FRAME BASE] = %08x\n", regs.frame_base);
+
+	/*
+	 * Writing the registers one by one in the middle of a frame garbles
+	 * it, so stage them for the interrupt handler to program during
+	 * vertical blanking.  Without a running LCD there is no vblank.
+	 */
+	spin_lock_irqsave(&ftlcdc100->flip_lock, flags);
+
+	ftlcdc100->commit_regs = regs;
+	ftlcdc100->commit_yoffset = info->var.yoffset;
+	ftlcdc100->commit_flip = ++ftlcdc100->flip_queued;
+	sequence = ++ftlcdc100->commit_queued;
+
+	running = ftlcdc100_read_reg(ftlcdc100, FTLCDC100_OFFSET_LCD_CONTROL)
+		& FTLCDC100_LCD_CONTROL_ENABLE;
+	if (!running)
+		ftlcdc100_commit_regs(ftlcdc100);
+
+	spin_unlock_irqrestore(&ftlcdc100->flip_lock, flags);
+
+	if (!running || ftlcdc100->commit_async)
+		return 0;
+
+	if (wait_event_interruptible_timeout(ftlcdc100->vsync_wait,
+			ftlcdc100_commit_done(ftlcdc100, sequence),
+			HZ / 10) > 0)
+		return 0;
+
+	/* no vblank in time (or a signal), do it now */
+	spin_lock_irqsave(&ftlcdc100->flip_lock, flags);
+	if (!ftlcdc100_commit_done(ftlcdc100, sequence))
+		ftlcdc100_commit_regs(ftlcdc100);
+	spin_unlock_irqrestore(&ftlcdc100->flip_lock, flags);
+
+	return 0;
+}
+
+/**
+ * ftlcdc100_setcolreg - Optional function. Sets a color register.
+ * @regno: Which register in the CLUT we are programming 
+ * @red: The red value which can be up to 16 bits wide 
+ * @green: The green value which can be up to 16 bits wide 
+ * @blue:  The blue value which can be up to 16 bits wide.
+ * @transp: If supported, the alpha value which can be up to 16 bits wide.
+ * @info: frame buffer info structure
+ * 
+ * Set a single color register. The values supplied have a 16 bit
+ * magnitude which needs to be scaled in this function for the hardware. 
+ * Things to take into consideration are how many color registers, if
+ * any, are supported with the current color visual. With truecolor mode
+ * no color palettes are supported. Here a pseudo palette is created
+ * which we store the value in pseudo_palette in struct fb_info. For
+ * pseudocolor mode we have a limited color palette. To deal with this
+ * we can program what color is displayed for a particular pixel value.
+ * DirectColor is similar in that we can program each color field. If
+ * we have a static colormap we don't need to implement this function. 
+ * 
+ * Returns negative errno on error, or zero on success.
+ */
+static int ftlcdc100_setcolreg(unsigned regno, unsigned red, unsigned green,
+	unsigned blue, unsigned transp, struct fb_info *info)
+{
+	struct device *dev = info->device;
+	struct ftlcdc100 *ftlcdc100 = info->par;
+	u32 val;
+
+	dev_dbg(dev, "%s(%d, %d, %d, %d, %d)\n", __func__,
+		regno, red, green, blue, transp);
+
+	if (regno >= 256)  /* no. of hw registers */
+		return -EINVAL;
+
+	if (info->fix.visual == FB_VISUAL_PSEUDOCOLOR) {
+		if (regno >= 1 << info->var.bits_per_pixel)
+			return -EINVAL;
+
+		ftlcdc100->palette[regno] = ftlcdc100_palette_entry(info,
+						red, green, blue);
+		ftlcdc100_write_palette(ftlcdc100, regno, regno);
+		return 0;
+	}
+
+	/*
+	 * If grayscale is true, then we convert the RGB value
+	 * to grayscale no mater what visual we are using.
+	 */
+	if (info->var.grayscale) {
+		/* grayscale = 0.30*R + 0.59*G + 0.11*B */
+		red = green = blue = (red * 77 + green * 151 + blue * 28) >> 8;
+	}
+
+#define CNVT_TOHW(val,width) ((((val) << (width)) + 0x7FFF - (val)) >> 16)
+	red = CNVT_TOHW(red, info->var.red.length);
+	green = CNVT_TOHW(green, info->var.green.length);
+	blue = CNVT_TOHW(blue, info->var.blue.length);
+	transp = CNVT_TOHW(transp, info->var.transp.length);
+#undef CNVT_TOHW
+
+	switch (info->fix.visual) {
+	case FB_VISUAL_TRUECOLOR:
+		if (regno >= 16)
+			return -EINVAL;
+		/*
+		 * The contents of the pseudo_palette is in raw pixel format.
+		 * Ie, each entry can be written directly to the framebuffer
+		 * without any conversion.
+		 */
+	
+		val = (red << info->var.red.offset);
+		val |= (green << info->var.green.offset);
+		val |= (blue << info->var.blue.offset);
+
+		ftlcdc100->pseudo_palette[regno] = val;
+
+		break;
+
+	default:
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+/**
+ * ftlcdc100_setcmap - Optional function. Sets a whole color map.
+ * @cmap: color map to set, starting at cmap->start
+ * @info: frame buffer info structure
+ *
+ * In pseudocolor mode all entries are converted first, then the palette
+ * words from the first to the last changed entry are written in a single
+ * pass.  Otherwise this is the same as calling ftlcdc100_setcolreg() for
+ * every entry.  As in the generic fb_set_cmap() path, entries beyond what
+ * the current depth has are ignored: the fb core loads the full 256 entry
+ * info->cmap after every mode set.
+ *
+ * Returns zero.
+ */
+static int ftlcdc100_setcmap(struct fb_cmap *cmap, struct fb_info *info)
+{
+	struct ftlcdc100 *ftlcdc100 = info->par;
+	unsigned int first = FTLCDC100_PALETTE_ENTRIES;
+	unsigned int last = 0;
+	unsigned int entries;
+	unsigned int regno;
+	unsigned int len;
+	unsigned int i;
+	u16 entry;
+
+	if (info->fix.visual != FB_VISUAL_PSEUDOCOLOR) {
+		for (i = 0; i < cmap->len; i++) {
+			if (ftlcdc100_setcolreg(cmap->start + i,
+				cmap->red[i], cmap->green[i], cmap->blue[i],
+				cmap->transp ? cmap->transp[i] : 0xffff, info))
+				break;
+		}
+
+		return 0;
+	}
+
+	entries = 1 << info->var.bits_per_pixel;
+	if (cmap->start >= entries)
+		return 0;
+
+	len = min(cmap->len, entries - cmap->start);
+
+	for (i = 0; i < len; i++) {
+		regno = cmap->start + i;
+		entry = ftlcdc100_palette_entry(info, cmap->red[i],
+				cmap->green[i], cmap->blue[i]);
+
+		if (entry == ftlcdc100->palette[regno])
+			continue;
+
+		ftlcdc100->palette[regno] = entry;
+		first = min(first, regno);
+		last = max(last, regno);
+	}
+
+	if (first <= last)
+		ftlcdc100_write_palette(ftlcdc100, first, last);
+
+	return 0;
+}
+
+/**
+ * ftlcdc100_pan_display - NOT a required function. Pans the display.
+ * @var: frame buffer variable screen structure
+ * @info: frame buffer structure that represents a single frame buffer
+ *
+ * Pan (or wrap, depending on the `vmode' field) the display using the
+ * `xoffset' and `yoffset' fields of the `var' structure.
+ * If the values don't fit, return -EINVAL.
+ *
+ * If FB_ACTIVATE_VBL is set in `activate', do not return until the
+ * controller has latched the new frame base.  This gives double-buffering
+ * clients a tear-free flip that is paced by the display.
+ *
+ * Returns negative errno on error, or zero on success.
+ */
+static int ftlcdc100_pan_display(struct fb_var_screeninfo *var,
+			       struct fb_info *info)
+{
+	struct device *dev = info->device;
+	struct ftlcdc100 *ftlcdc100 = info->par;
+	unsigned long flags;
+	unsigned int value;
+	int ret;
+
+	dev_dbg(dev, "%s\n", __func__);
+
+	ret = ftlcdc100_yoffset_to_base(info, var->yoffset, &value);
+	if (ret)
+		return ret;
+
+	/* show what has been drawn so far, not what was a frame ago */
+	if (ftlcdc100->defio)
+		ftlcdc100_flush_damage(info);
+
+	/*
+	 * A synchronous pan overrides any queued flips.  It takes the next
+	 * sequence number, so the buffers of the dropped flips count as
+	 * retired once it is on screen.
+	 */
+	spin_lock_irqsave(&ftlcdc100->flip_lock, flags);
+
+	if (ftlcdc100->commit_done != ftlcdc100->commit_queued) {
+		/* shown together with the staged mode */
+		ftlcdc100->commit_regs.frame_base = value;
+		ftlcdc100->commit_yoffset = var->yoffset;
+	} else {
+		ftlcdc100->flip_count = 0;
+		ftlcdc100->flip_latch.frame_base = value;
+		ftlcdc100->flip_latch.yoffset = var->yoffset;
+		ftlcdc100->flip_latch.sequence = ++ftlcdc100->flip_queued;
+		ftlcdc100->flip_latched = 1;
+
+		ftlcdc100_write_reg(ftlcdc100,
+			FTLCDC100_OFFSET_LCD_FRAME_BASE, value);
+	}
+
+	spin_unlock_irqrestore(&ftlcdc100->flip_lock, flags);
+
+	dev_dbg(dev, "  [LCD FRAME BASE] = %08x\n", value);
+
+	if (var->activate & FB_ACTIVATE_VBL)
+		return ftlcdc100_wait_for_vsync(info);
+
+	return 0;
+}
+
+/**
+ * ftlcdc100_osd_set_window - Enable, place and size the OSD.
+ * @info: frame buffer structure that represents a single frame buffer
+ * @win: new OSD window
+ *
+ * Returns negative errno on error, or zero on success.
+ */
+static int ftlcdc100_osd_set_window(struct fb_info *info,
+	const struct ftlcdc100_osd_window *win)
+{
+	struct ftlcdc100 *ftlcdc100 = info->par;
+	unsigned int position;
+	unsigned int reg;
+
+	if (!ftlcdc100->osd_mapped)
+		return -ENODEV;
+
+	if (win->columns == 0 || win->columns > 64
+	||  win->rows == 0 || win->rows > 32
+	||  win->columns * win->rows > FTLCDC100_OSD_CELLS)
+		return -EINVAL;
+
+	if (win->hscale > 3 || win->vscale > 3)
+		return -EINVAL;
+
+	if (win->x >= info->var.xres || win->y >= info->var.yres)
+		return -EINVAL;
+
+	position = FTLCDC100_OSD_POSITION_CONTROL_HPOS(win->x)
+		 | FTLCDC100_OSD_POSITION_CONTROL_VPOS(win->y);
+
+	reg = FTLCDC100_OSD_SCALING_CONTROL_VSCAL(win->vscale)
+	    | FTLCDC100_OSD_SCALING_CONTROL_HSCAL(win->hscale)
+	    | FTLCDC100_OSD_SCALING_CONTROL_VDIM(win->rows - 1)
+	    | FTLCDC100_OSD_SCALING_CONTROL_HDIM(win->columns - 1);
+
+	if (win->enable)
+		reg |= FTLCDC100_OSD_SCALING_CONTROL_ENABLE;
+
+	ftlcdc100->osd_text = win->enable;
+
+	ftlcdc100_write_reg(ftlcdc100, FTLCDC100_OFFSET_OSD_POSITION_CONTROL,
+		position);
+	ftlcdc100_write_reg(ftlcdc100, FTLCDC100_OFFSET_OSD_SCALING_CONTROL,
+		reg);
+	return 0;
+}
+
+/**
+ * ftlcdc100_osd_set_glyph - Load one glyph into the OSD font RAM.
+ * @ftlcdc100: driver private data
+ * @glyph: glyph index and bitmap
+ *
+ * Returns negative errno on error, or zero on success.
+ */
+static int ftlcdc100_osd_set_glyph(struct ftlcdc100 *ftlcdc100,
+	const struct ftlcdc100_osd_glyph *glyph)
+{
+	void *font;
+	int i;
+
+	if (!ftlcdc100->osd_mapped)
+		return -ENODEV;
+
+	if (glyph->index >= FTLCDC100_OSD_GLYPHS)
+		return -EINVAL;
+
+	font = ftlcdc100->base + FTLCDC100_OFFSET_OSD_FONT
+	     + glyph->index * FTLCDC100_OSD_GLYPH_HEIGHT * 4;
+
+	for (i = 0; i < FTLCDC100_OSD_GLYPH_HEIGHT; i++)
+		iowrite32(glyph->bitmap[i], font + i * 4);
+
+	return 0;
+}
+
+/**
+ * ftlcdc100_osd_set_attribute - Write cells of the OSD attribute RAM.
+ * @ftlcdc100: driver private data
+ * @attr: first cell, number of cells and their attributes
+ *
+ * Returns negative errno on error, or zero on success.
+ */
+static int ftlcdc100_osd_set_attribute(struct ftlcdc100 *ftlcdc100,
+	const struct ftlcdc100_osd_attribute *attr)
+{
+	unsigned int i;
+
+	if (!ftlcdc100->osd_mapped)
+		return -ENODEV;
+
+	if (attr->count > FTLCDC100_OSD_ATTRIBUTE_BATCH
+	||  attr->start >= FTLCDC100_OSD_CELLS
+	||  attr->count > FTLCDC100_OSD_CELLS - attr->start)
+		return -EINVAL;
+
+	for (i = 0; i < attr->count; i++)
+		iowrite32(attr->attribute[i], ftlcdc100->base
+			+ FTLCDC100_OFFSET_OSD_ATTRIBUTE
+			+ (attr->start + i) * 4);
+
+	return 0;
+}
+
+/**
+ * ftlcdc100_cursor_show - Move, show or hide the OSD cursor.
+ * @info: frame buffer structure that represents a single frame buffer
+ * @x: left edge of the cursor
+ * @y: top edge of the cursor
+ * @enable: show the cursor if non-zero
+ *
+ * Moving a visible cursor is a single register write.
+ *
+ * Returns negative errno on error, or zero on success.
+ */
+static int ftlcdc100_cursor_show(struct fb_info *info, unsigned int x,
+	unsigned int y, int enable)
+{
+	struct ftlcdc100 *ftlcdc100 = info->par;
+	unsigned int position;
+	unsigned int scaling;
+
+	if (!ftlcdc100->osd_mapped)
+		return -ENODEV;
+
+	if (ftlcdc100->osd_text)
+		return -EBUSY;
+
+	if (x >= info->var.xres || y >= info->var.yres) {
+		/* do not leave the cursor behind at its old position */
+		if (ftlcdc100_read_reg(ftlcdc100,
+				FTLCDC100_OFFSET_OSD_SCALING_CONTROL))
+			ftlcdc100_write_reg(ftlcdc100,
+				FTLCDC100_OFFSET_OSD_SCALING_CONTROL, 0);
+		return -EINVAL;
+	}
+
+	position = FTLCDC100_OSD_POSITION_CONTROL_HPOS(x)
+		 | FTLCDC100_OSD_POSITION_CONTROL_VPOS(y);
+
+	ftlcdc100_update_reg(ftlcdc100, FTLCDC100_OFFSET_OSD_POSITION_CONTROL,
+		position);
+
+	/* a 1x1 window at scale 1 */
+	scaling = enable ? FTLCDC100_OSD_SCALING_CONTROL_ENABLE : 0;
+
+	if (scaling != ftlcdc100_read_reg(ftlcdc100,
+				FTLCDC100_OFFSET_OSD_SCALING_CONTROL)) {
+		/* the cell may have been used for text meanwhile */
+		if (enable)
+			iowrite32(FTLCDC100_OSD_ATTRIBUTE_FONT(
+					FTLCDC100_OSD_CURSOR_GLYPH)
+				| FTLCDC100_OSD_ATTRIBUTE_FG(0),
+				ftlcdc100->base + FTLCDC100_OFFSET_OSD_ATTRIBUTE);
+
+		ftlcdc100_write_reg(ftlcdc100,
+			FTLCDC100_OFFSET_OSD_SCALING_CONTROL, scaling);
+	}
+
+	return 0;
+}
+
+/**
+ * ftlcdc100_cursor - Draw the console cursor with the OSD.
+ * @info: frame buffer structure that represents a single frame buffer
+ * @cursor: cursor shape, colors and position
+ *
+ * The cursor image is loaded as FTLCDC100_OSD_CURSOR_GLYPH.  Set pixels are
+ * drawn in the foreground color and the rest is transparent, so the cell
+ * under the cursor stays visible.  Cursors bigger than a glyph, or any
+ * cursor while OSD text is shown, are refused and fbcon falls back to
+ * its software cursor.
+ *
+ * Returns negative errno on error, or zero on success.
+ */
+static int ftlcdc100_cursor(struct fb_info *info, struct fb_cursor *cursor)
+{
+	struct ftlcdc100 *ftlcdc100 = info->par;
+	const struct fb_image *image = &cursor->image;
+	struct ftlcdc100_osd_glyph glyph;
+	unsigned int pitch = DIV_ROUND_UP(image->width, 8);
+	const u8 *data = (const u8 *)image->data;
+	const u8 *mask = (const u8 *)cursor->mask;
+	unsigned int x;
+	unsigned int y;
+	u16 pixel;
+	u8 bits;
+
+	if (!ftlcdc100->osd_mapped)
+		return -ENODEV;
+
+	if (ftlcdc100->osd_text)
+		return -EBUSY;
+
+	if (image->width > FTLCDC100_OSD_GLYPH_WIDTH
+	||  image->height > FTLCDC100_OSD_GLYPH_HEIGHT)
+		return -EINVAL;
+
+	if ((cursor->set & (FB_CUR_SETIMAGE | FB_CUR_SETSHAPE))
+	&&  data && mask) {
+		memset(&glyph, 0, sizeof(glyph));
+		glyph.index = FTLCDC100_OSD_CURSOR_GLYPH;
+
+		for (y = 0; y < image->height; y++) {
+			/* bit 11 is the leftmost pixel */
+			pixel = 1 << (FTLCDC100_OSD_GLYPH_WIDTH - 1);
+
+			for (x = 0; x < image->width; x++, pixel >>= 1) {
+				if (cursor->rop == ROP_XOR)
+					bits = data[x / 8] ^ mask[x / 8];
+				else
+					bits = data[x / 8] & mask[x / 8];
+
+				if (bits & (0x80 >> (x % 8)))
+					glyph.bitmap[y] |= pixel;
+			}
+
+			data += pitch;
+			mask += pitch;
+		}
+
+		ftlcdc100_osd_set_glyph(ftlcdc100, &glyph);
+	}
+
+	if (cursor->set & FB_CUR_SETCMAP) {
+		ftlcdc100_write_reg(ftlcdc100, FTLCDC100_OFFSET_OSD_FG_CONTROL,
+			FTLCDC100_OSD_FG_CONTROL_PAL(0, image->fg_color));
+		ftlcdc100_write_reg(ftlcdc100, FTLCDC100_OFFSET_OSD_BG_CONTROL,
+			FTLCDC100_OSD_BG_CONTROL_TRANS(0));
+	}
+
+	/*
+	 * fbcon gives the position in the virtual screen; a cursor above the
+	 * panned window wraps to a large row and is hidden as off screen
+	 */
+	return ftlcdc100_cursor_show(info, image->dx,
+		image->dy - info->var.yoffset, cursor->enable);
+}
+
+/**
+ * ftlcdc100_ioctl - Handler for device-specific ioctls.
+ * @info: frame buffer structure that represents a single frame buffer
+ * @cmd: ioctl command
+ * @arg: ioctl argument
+ *
+ * Returns negative errno on error, or zero on success.
+ */
+static int ftlcdc100_ioctl(struct fb_info *info, unsigned int cmd,
+			   unsigned long arg)
+{
+	struct ftlcdc100 *ftlcdc100 = info->par;
+	void __user *argp = (void __user *)arg;
+	struct ftlcdc100_flip_status status;
+	struct ftlcdc100_flip flip;
+	struct ftlcdc100_phys_flip phys_flip;
+	struct ftlcdc100_rect rect;
+	struct ftlcdc100_osd_window osd_window;
+	struct ftlcdc100_osd_glyph osd_glyph;
+	struct ftlcdc100_osd_attribute osd_attr;
+	struct ftlcdc100_osd_color osd_color;
+	struct ftlcdc100_cursor cursor;
+	struct ftlcdc100_buffer buffer;
+	unsigned long flags;
+	long timeout;
+	u32 sequence;
+	u32 async;
+	u32 crtc;
+	int ret;
+
+	switch (cmd) {
+	case FBIO_WAITFORVSYNC:
+		if (get_user(crtc, (u32 __user *)argp))
+			return -EFAULT;
+
+		/* we have only one output */
+		if (crtc != 0)
+			return -ENODEV;
+
+		return ftlcdc100_wait_for_vsync(info);
+
+	case FTLCDC100IOC_QUEUE_FLIP:
+		if (copy_from_user(&flip, argp, sizeof(flip)))
+			return -EFAULT;
+
+		/* show what has been drawn so far, not what was a frame ago */
+		if (ftlcdc100->defio)
+			ftlcdc100_flush_damage(info);
+
+		ret = ftlcdc100_queue_flip(info, &flip);
+		if (ret)
+			return ret;
+
+		if (copy_to_user(argp, &flip, sizeof(flip)))
+			return -EFAULT;
+
+		return 0;
+
+	case FTLCDC100IOC_QUEUE_PHYS_FLIP:
+		/* the controller would show whatever memory it is pointed at */
+		if (!capable(CAP_SYS_RAWIO))
+			return -EPERM;
+
+		if (copy_from_user(&phys_flip, argp, sizeof(phys_flip)))
+			return -EFAULT;
+
+		ret = ftlcdc100_queue_phys_flip(info, &phys_flip);
+		if (ret)
+			return ret;
+
+		if (copy_to_user(argp, &phys_flip, sizeof(phys_flip)))
+			return -EFAULT;
+
+		return 0;
+
+	case FTLCDC100IOC_GET_FLIP_STATUS:
+		spin_lock_irqsave(&ftlcdc100->flip_lock, flags);
+		status.queued = ftlcdc100->flip_queued;
+		status.displayed = ftlcdc100->flip_displayed;
+		status.yoffset = ftlcdc100->flip_yoffset;
+		status.pending = ftlcdc100->flip_count + ftlcdc100->flip_latched;
+		spin_unlock_irqrestore(&ftlcdc100->flip_lock, flags);
+
+		if (copy_to_user(argp, &status, sizeof(status)))
+			return -EFAULT;
+
+		return 0;
+
+	case FTLCDC100IOC_WAIT_FLIP:
+		if (get_user(sequence, (u32 __user *)argp))
+			return -EFAULT;
+
+		/* allow one frame per queued flip plus some slack */
+		timeout = wait_event_interruptible_timeout(
+				ftlcdc100->vsync_wait,
+				ftlcdc100_flip_done(ftlcdc100, sequence),
+				(FTLCDC100_FLIP_QUEUE_LEN + 1) * HZ / 10);
+		if (timeout < 0)
+			return timeout;
+
+		if (timeout == 0)
+			return -ETIMEDOUT;
+
+		return 0;
+
+	case FTLCDC100IOC_DAMAGE:
+		if (copy_from_user(&rect, argp, sizeof(rect)))
+			return -EFAULT;
+
+		if (rect.y >= info->var.yres_virtual)
+			return -EINVAL;
+
+		ftlcdc100_damage(info, rect.y,
+			min(rect.height, info->var.yres_virtual - rect.y));
+		return 0;
+
+	case FTLCDC100IOC_OSD_SET_WINDOW:
+		if (copy_from_user(&osd_window, argp, sizeof(osd_window)))
+			return -EFAULT;
+
+		return ftlcdc100_osd_set_window(info, &osd_window);
+
+	case FTLCDC100IOC_OSD_SET_GLYPH:
+		if (copy_from_user(&osd_glyph, argp, sizeof(osd_glyph)))
+			return -EFAULT;
+
+		return ftlcdc100_osd_set_glyph(ftlcdc100, &osd_glyph);
+
+	case FTLCDC100IOC_OSD_SET_ATTRIBUTE:
+		if (copy_from_user(&osd_attr, argp, sizeof(osd_attr)))
+			return -EFAULT;
+
+		return ftlcdc100_osd_set_attribute(ftlcdc100, &osd_attr);
+
+	case FTLCDC100IOC_OSD_SET_COLOR:
+		if (!ftlcdc100->osd_mapped)
+			return -ENODEV;
+
+		if (copy_from_user(&osd_color, argp, sizeof(osd_color)))
+			return -EFAULT;
+
+		ftlcdc100_write_reg(ftlcdc100, FTLCDC100_OFFSET_OSD_FG_CONTROL,
+			osd_color.fg);
+		ftlcdc100_write_reg(ftlcdc100, FTLCDC100_OFFSET_OSD_BG_CONTROL,
+			osd_color.bg);
+		return 0;
+
+	case FTLCDC100IOC_SET_CURSOR:
+		if (copy_from_user(&cursor, argp, sizeof(cursor)))
+			return -EFAULT;
+
+		return ftlcdc100_cursor_show(info, cursor.x, cursor.y,
+			cursor.enable);
+
+	case FTLCDC100IOC_SET_ASYNC_COMMIT:
+		if (get_user(async, (u32 __user *)argp))
+			return -EFAULT;
+
+		ftlcdc100->commit_async = !!async;
+		return 0;
+
+	case FTLCDC100IOC_GET_BUFFER:
+		if (copy_from_user(&buffer, argp, sizeof(buffer)))
+			return -EFAULT;
+
+		ret = ftlcdc100_get_buffer(info, &buffer);
+		if (ret)
+			return ret;
+
+		if (copy_to_user(argp, &buffer, sizeof(buffer)))
+			return -EFAULT;
+
+		return 0;
+
+	default:
+		return -ENOTTY;
+	}
+}
+
+/******************************************************************************
+ * drawing functions
+ *
+ * fbcon and most clients only use 16bpp and 32bpp, where a pixel is never
+ * split across a word.  Handle those with plain word stores and memmove() and
+ * leave the remaining depths and ROP_XOR to the generic cfb_* helpers.
+ *****************************************************************************/
+/**
+ * ftlcdc100_fill_line - Fill @len bytes at @dst with a repeated pattern.
+ * @dst: first byte to fill, at least 16-bit aligned
+ * @pattern: one 32-bit word of pixels
+ * @len: number of bytes, a multiple of 2
+ */
+static void ftlcdc100_fill_line(u8 *dst, u32 pattern, unsigned int len)
+{
+	u32 *dst32;
+
+	/* leading half word up to the next word boundary */
+	if (((unsigned long)dst & 2) && len >= 2) {
+		*(u16 *)dst = pattern;
+		dst += 2;
+		len -= 2;
+	}
+
+	dst32 = (u32 *)dst;
+
+	/* four words at a time, so the write buffer can burst */
+	while (len >= 16) {
+		dst32[0] = pattern;
+		dst32[1] = pattern;
+		dst32[2] = pattern;
+		dst32[3] = pattern;
+		dst32 += 4;
+		len -= 16;
+	}
+
+	while (len >= 4) {
+		*dst32++ = pattern;
+		len -= 4;
+	}
+
+	if (len >= 2)
+		*(u16 *)dst32 = pattern;
+}
+
+static void ftlcdc100_fillrect(struct fb_info *info,
+	const struct fb_fillrect *rect)
+{
+	unsigned int bpp = info->var.bits_per_pixel;
+	unsigned int line_length = info->fix.line_length;
+	unsigned int len;
+	unsigned int height;
+	u32 pattern;
+	u8 *dst;
+
+	if (info->state != FBINFO_STATE_RUNNING)
+		return;
+
+	if ((bpp != 16 && bpp != 32) || rect->rop != ROP_COPY) {
+		cfb_fillrect(info, rect);
+		ftlcdc100_damage(info, rect->dy, rect->height);
+		return;
+	}
+
+	if (info->fix.visual == FB_VISUAL_TRUECOLOR)
+		pattern = ((u32 *)info->pseudo_palette)[rect->color];
+	else
+		pattern = rect->color;
+
+	if (bpp == 16) {
+		pattern &= 0xffff;
+		pattern |= pattern << 16;
+	}
+
+	dst = (u8 *)info->screen_base + rect->dy * line_length
+	    + rect->dx * (bpp / 8);
+	len = rect->width * (bpp / 8);
+
+	for (height = rect->height; height; height--) {
+		ftlcdc100_fill_line(dst, pattern, len);
+		dst += line_length;
+	}
+
+	ftlcdc100_damage(info, rect->dy, rect->height);
+}
+
+/**
+ * ftlcdc100_glyph_lookup - Find or build the expanded spans for fg/bg.
+ * @info: frame buffer structure that represents a single frame buffer
+ * @fg: foreground pixel value
+ * @bg: background pixel value
+ *
+ * Returns 256 spans of 8 pixels each, in the current pixel format.
+ */
+static const u32 *ftlcdc100_glyph_lookup(struct fb_info *info, u32 fg, u32 bg)
+{
+	struct ftlcdc100 *ftlcdc100 = info->par;
+	struct ftlcdc100_glyph_slot *slot;
+	unsigned int bits;
+	unsigned int i;
+	u32 *span;
+
+	for (i = 0; i < FTLCDC100_GLYPH_CACHE_SLOTS; i++) {
+		slot = &ftlcdc100->glyph_slot[i];
+		if (slot->valid && slot->fg == fg && slot->bg == bg)
+			return slot->spans;
+	}
+
+	/* miss: replace slots round robin */
+	slot = &ftlcdc100->glyph_slot[ftlcdc100->glyph_victim];
+	ftlcdc100->glyph_victim = (ftlcdc100->glyph_victim + 1)
+				% FTLCDC100_GLYPH_CACHE_SLOTS;
+
+	span = slot->spans;
+	for (bits = 0; bits < 256; bits++) {
+		if (info->var.bits_per_pixel == 16) {
+			u16 *pixel = (u16 *)span;
+
+			for (i = 0; i < 8; i++)
+				pixel[i] = (bits & (0x80 >> i)) ? fg : bg;
+		} else {
+			for (i = 0; i < 8; i++)
+				span[i] = (bits & (0x80 >> i)) ? fg : bg;
+		}
+
+		span += FTLCDC100_GLYPH_SPAN_WORDS;
+	}
+
+	slot->fg = fg;
+	slot->bg = bg;
+	slot->valid = 1;
+	return slot->spans;
+}
+
+/*
+ * Draw a 1bpp image by copying pre-expanded 8 pixel spans out of the glyph
+ * cache.  A console glyph row is one byte, so a hit is a plain row copy.
+ */
+static void ftlcdc100_imageblit(struct fb_info *info,
+	const struct fb_image *image)
+{
+	unsigned int bpp = info->var.bits_per_pixel;
+	unsigned int line_length = info->fix.line_length;
+	unsigned int pitch = DIV_ROUND_UP(image->width, 8);
+	unsigned int span_len = 8 * (bpp / 8);
+	const u8 *src = (const u8 *)image->data;
+	const u32 *spans;
+	unsigned int x;
+	unsigned int y;
+	u32 fg;
+	u32 bg;
+	u8 *dst;
+
+	if (info->state != FBINFO_STATE_RUNNING)
+		return;
+
+	if ((bpp != 16 && bpp != 32) || image->depth != 1) {
+		cfb_imageblit(info, image);
+		ftlcdc100_damage(info, image->dy, image->height);
+		return;
+	}
+
+	if (info->fix.visual == FB_VISUAL_TRUECOLOR) {
+		fg = ((u32 *)info->pseudo_palette)[image->fg_color];
+		bg = ((u32 *)info->pseudo_palette)[image->bg_color];
+	} else {
+		fg = image->fg_color;
+		bg = image->bg_color;
+	}
+
+	spans = ftlcdc100_glyph_lookup(info, fg, bg);
+
+	dst = (u8 *)info->screen_base + image->dy * line_length
+	    + image->dx * (bpp / 8);
+
+	for (y = 0; y < image->height; y++) {
+		u8 *d = dst;
+
+		for (x = 0; x + 8 <= image->width; x += 8) {
+			const u32 *span = spans
+				+ src[x / 8] * FTLCDC100_GLYPH_SPAN_WORDS;
+
+			if (((unsigned long)d & 3) == 0) {
+				u32 *d32 = (u32 *)d;
+
+				d32[0] = span[0];
+				d32[1] = span[1];
+				d32[2] = span[2];
+				d32[3] = span[3];
+				if (bpp == 32) {
+					d32[4] = span[4];
+					d32[5] = span[5];
+					d32[6] = span[6];
+					d32[7] = span[7];
+				}
+			} else {
+				memcpy(d, span, span_len);
+			}
+
+			d += span_len;
+		}
+
+		/* trailing pixels of a glyph that is not a multiple of 8 wide */
+		if (x < image->width)
+			memcpy(d, spans + src[x / 8] * FTLCDC100_GLYPH_SPAN_WORDS,
+				(image->width - x) * (bpp / 8));
+
+		src += pitch;
+		dst += line_length;
+	}
+
+	ftlcdc100_damage(info, image->dy, image->height);
+}
+
+/**
+ * ftlcdc100_write_flip_begin - Pick the back buffer for the next frame.
+ * @info: frame buffer structure that represents a single frame buffer
+ *
+ * The buffer after the one last flipped to is used.  It may still be on
+ * screen, so wait until enough flips have been retired.
+ *
+ * Returns negative errno on error, or zero on success.
+ */
+static int ftlcdc100_write_flip_begin(struct fb_info *info)
+{
+	struct ftlcdc100 *ftlcdc100 = info->par;
+	unsigned int buffers = info->var.yres_virtual / info->var.yres;
+	unsigned int limit = min_t(unsigned int, buffers - 1,
+					  FTLCDC100_FLIP_QUEUE_LEN);
+	long timeout;
+
+	timeout = wait_event_interruptible_timeout(ftlcdc100->vsync_wait,
+			ftlcdc100_flip_pending(ftlcdc100) < limit,
+			(FTLCDC100_FLIP_QUEUE_LEN + 1) * HZ / 10);
+	if (timeout < 0)
+		return timeout;
+
+	if (timeout == 0)
+		return -ETIMEDOUT;
+
+	ftlcdc100->write_yoffset = (info->var.yoffset / info->var.yres + 1)
+				 % buffers * info->var.yres;
+	return 0;
+}
+
+/*
+ * fb_read and fb_write copy straight between user memory and the frame
+ * buffer (the shadow buffer in deferred I/O mode) instead of bouncing
+ * through a page sized kernel buffer.  Large chunks let copy_{from,to}_user
+ * run its unrolled load/store multiple loop, which turns into bursts on the
+ * bus when the user buffer is word aligned.
+ */
+static ssize_t ftlcdc100_read(struct fb_info *info, char __user *buf,
+	size_t count, loff_t *ppos)
+{
+	unsigned long total = info->fix.smem_len;
+	unsigned long p = *ppos;
+	unsigned long left;
+	size_t done = 0;
+	size_t n;
+
+	if (info->state != FBINFO_STATE_RUNNING)
+		return -EPERM;
+
+	if (p >= total)
+		return 0;
+
+	if (count > total - p)
+		count = total - p;
+
+	while (done < count) {
+		n = min_t(size_t, count - done, FTLCDC100_COPY_CHUNK);
+		left = copy_to_user(buf + done, info->screen_base + p + done,
+				    n);
+		done += n - left;
+		if (left)
+			break;
+
+		cond_resched();
+	}
+
+	if (done == 0)
+		return -EFAULT;
+
+	*ppos += done;
+	return done;
+}
+
+/*
+ * In write flip mode the file offset addresses one frame, which is written
+ * to the back buffer.  Completing the frame queues a flip to it and wraps
+ * the offset, so a stream of frames written with `cat' is shown one by one
+ * without tearing.  In deferred I/O mode the written lines must be copied
+ * to the screen afterwards, and before a flip to them.  If the flip cannot
+ * be queued, e.g. while a mode set waits for vblank, the write that would
+ * complete the frame fails and the file offset stays, so it can be retried.
+ */
+static ssize_t ftlcdc100_write(struct fb_info *info, const char __user *buf,
+	size_t count, loff_t *ppos)
+{
+	struct ftlcdc100 *ftlcdc100 = info->par;
+	unsigned int line_length = info->fix.line_length;
+	unsigned long total = info->fix.smem_len;
+	unsigned long p = *ppos;
+	unsigned long base = 0;
+	unsigned long left;
+	struct ftlcdc100_flip flip;
+	size_t done = 0;
+	size_t n;
+	int write_flip;
+	int err = 0;
+
+	if (info->state != FBINFO_STATE_RUNNING)
+		return -EPERM;
+
+	write_flip = ftlcdc100->write_flip
+		  && info->var.yres_virtual >= 2 * info->var.yres;
+	if (write_flip) {
+		total = ftlcdc100_frame_size(&info->var);
+		if (p == 0) {
+			err = ftlcdc100_write_flip_begin(info);
+			if (err)
+				return err;
+		}
+		base = ftlcdc100->write_yoffset / info->var.yres * total;
+	}
+
+	if (p > total)
+		return -EFBIG;
+
+	if (count > total - p) {
+		err = count > total ? -EFBIG : -ENOSPC;
+		count = total - p;
+	}
+
+	while (done < count) {
+		n = min_t(size_t, count - done, FTLCDC100_COPY_CHUNK);
+		left = copy_from_user(info->screen_base + base + p + done,
+				      buf + done, n);
+		done += n - left;
+		if (left) {
+			err = -EFAULT;
+			break;
+		}
+
+		cond_resched();
+	}
+
+	if (done == 0)
+		return err;
+
+	ftlcdc100_damage(info, (base + p) / line_length,
+		(base + p + done - 1) / line_length
+		- (base + p) / line_length + 1);
+
+	if (write_flip && p + done == total) {
+		/* the frame is still in the shadow buffer */
+		if (ftlcdc100->defio)
+			ftlcdc100_flush_damage(info);
+
+		flip.yoffset = ftlcdc100->write_yoffset;
+		err = ftlcdc100_queue_flip(info, &flip);
+		if (err)
+			return err;
+
+		*ppos = 0;
+		return done;
+	}
+
+	*ppos += done;
+	return done;
+}
+
+static void ftlcdc100_copyarea(struct fb_info *info,
+	const struct fb_copyarea *area)
+{
+	unsigned int bpp = info->var.bits_per_pixel;
+	unsigned int line_length = info->fix.line_length;
+	unsigned int len;
+	unsigned int height;
+	u8 *dst;
+	u8 *src;
+
+	if (info->state != FBINFO_STATE_RUNNING)
+		return;
+
+	if (bpp != 16 && bpp != 32) {
+		cfb_copyarea(info, area);
+		ftlcdc100_damage(info, area->dy, area->height);
+		return;
+	}
+
+	dst = (u8 *)info->screen_base + area->dy * line_length
+	    + area->dx * (bpp / 8);
+	src = (u8 *)info->screen_base + area->sy * line_length
+	    + area->sx * (bpp / 8);
+	len = area->width * (bpp / 8);
+
+	/* full lines are contiguous, e.g. a console scroll */
+	if (len == line_length) {
+		memmove(dst, src, len * area->height);
+		ftlcdc100_damage(info, area->dy, area->height);
+		return;
+	}
+
+	/*
+	 * memmove() takes care of overlap within a line.  Between lines, walk
+	 * upwards when moving down so the source is read before it is
+	 * overwritten.
+	 */
+	if (area->dy > area->sy) {
+		dst += (area->height - 1) * line_length;
+		src += (area->height - 1) * line_length;
+
+		for (height = area->height; height; height--) {
+			memmove(dst, src, len);
+			dst -= line_length;
+			src -= line_length;
+		}
+	} else {
+		for (height = area->height; height; height--) {
+			memmove(dst, src, len);
+			dst += line_length;
+			src += line_length;
+		}
+	}
+
+	ftlcdc100_damage(info, area->dy, area->height);
+}
+
+/******************************************************************************
+ * debugfs
+ *****************************************************************************/
+/**
+ * ftlcdc100_show_stats - Show the interrupt counters and the frame pacing.
+ * @m: seq_file to print to
+ * @unused: unused
+ *
+ * The frame period is measured between the vblank timestamps in the ring;
+ * jitter is the difference between the longest and the shortest period.
+ */
+static int ftlcdc100_show_stats(struct seq_file *m, void *unused)
+{
+	struct ftlcdc100 *ftlcdc100 = m->private;
+	struct ftlcdc100_stats stats;
+	unsigned int frames;
+	unsigned int index;
+	unsigned long flags;
+	u32 shortest = ~0;
+	u32 longest = 0;
+	u64 sum = 0;
+	u32 period;
+	int i;
+
+	spin_lock_irqsave(&ftlcdc100->stats_lock, flags);
+
+	stats = ftlcdc100->stats;
+	frames = min_t(unsigned long, stats.next_base, FTLCDC100_VBLANK_RING);
+	index = ftlcdc100->vblank_head + FTLCDC100_VBLANK_RING - frames;
+
+	for (i = 1; i < frames; i++, index++) {
+		period = ktime_to_ns(ktime_sub(
+			ftlcdc100->vblank_time[(index + 1)
+					       % FTLCDC100_VBLANK_RING],
+			ftlcdc100->vblank_time[index
+					       % FTLCDC100_VBLANK_RING]));
+		shortest = min(shortest, period);
+		longest = max(longest, period);
+		sum += period;
+	}
+
+	spin_unlock_irqrestore(&ftlcdc100->stats_lock, flags);
+
+	seq_printf(m, "underrun:       %lu\n", stats.underrun);
+	seq_printf(m, "next_base:      %lu\n", stats.next_base);
+	seq_printf(m, "vstatus:        %lu\n", stats.vstatus);
+	seq_printf(m, "bus_error:      %lu\n", stats.bus_error);
+	seq_printf(m, "fifo_threshold: %d\n", ftlcdc100->fifo_threshold);
+
+	if (frames < 2)
+		return 0;
+
+	do_div(sum, frames - 1);
+	seq_printf(m, "period (us):    %u mean, %u min, %u max, %u frames\n",
+		(u32)sum / 1000, shortest / 1000, longest / 1000, frames - 1);
+	seq_printf(m, "jitter (us):    %u\n", (longest - shortest) / 1000);
+	return 0;
+}
+
+static int ftlcdc100_open_stats(struct inode *inode, struct file *file)
+{
+	return single_open(file, ftlcdc100_show_stats, inode->i_private);
+}
+
+static const struct file_operations ftlcdc100_stats_fops = {
+	.owner		= THIS_MODULE,
+	.open		= ftlcdc100_open_stats,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+/**
+ * ftlcdc100_show_vblank - Show the vblank timestamps, oldest first.
+ * @m: seq_file to print to
+ * @unused: unused
+ */
+static int ftlcdc100_show_vblank(struct seq_file *m, void *unused)
+{
+	struct ftlcdc100 *ftlcdc100 = m->private;
+	ktime_t time[FTLCDC100_VBLANK_RING];
+	unsigned int frames;
+	unsigned int index;
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&ftlcdc100->stats_lock, flags);
 
-	/*
-	 * LCD horizontal timing control
-	 */
-	reg = FTLCDC100_LCD_HTIMING_PL(info->var.xres / 16 - 1);
-	reg |= FTLCDC100_LCD_HTIMING_HW(info->var.hsync_len - 1);
-	reg |= FTLCDC100_LCD_HTIMING_HFP(info->var.right_margin - 1);
-	reg |= FTLCDC100_LCD_HTIMING_HBP(info->var.left_margin - 1);
+	frames = min_t(unsigned long, ftlcdc100->stats.next_base,
+		FTLCDC100_VBLANK_RING);
+	index = ftlcdc100->vblank_head + FTLCDC100_VBLANK_RING - frames;
+	for (i = 0; i < frames; i++)
+		time[i] = ftlcdc100->vblank_time[(index + i)
+						 % FTLCDC100_VBLANK_RING];
 
-	dev_dbg(dev, "  [LCD HTIMING] = %08x\n", reg);
-	iowrite32(reg, ftlcdc100->base + FTLCDC100_OFFSET_LCD_HTIMING);
+	spin_unlock_irqrestore(&ftlcdc100->stats_lock, flags);
 
-	/*
-	 * LCD vertical timing control
-	 */
-	reg = FTLCDC100_LCD_VTIMING_LF(info->var.yres - 1);
-	reg |= FTLCDC100_LCD_VTIMING_VW(info->var.vsync_len - 1);
-	reg |= FTLCDC100_LCD_VTIMING_VFP(info->var.lower_margin);
-	reg |= FTLCDC100_LCD_VTIMING_VBP(info->var.upper_margin);
+	for (i = 0; i < frames; i++)
+		seq_printf(m, "%lld\n", (long long)ktime_to_ns(time[i]));
 
-	dev_dbg(dev, "  [LCD VTIMING] = %08x\n", reg);
-	iowrite32(reg, ftlcdc100->base + FTLCDC100_OFFSET_LCD_VTIMING);
+	return 0;
+}
 
-	/*
-	 * LCD Panel Pixel Parameters
-	 */
-	reg = FTLCDC100_LCD_CONTROL_ENABLE
-	    | FTLCDC100_LCD_CONTROL_TFT
-	    | FTLCDC100_LCD_CONTROL_BGR
-	    | FTLCDC100_LCD_CONTROL_LEB_LEP
-	    | FTLCDC100_LCD_CONTROL_LCD;
+static int ftlcdc100_open_vblank(struct inode *inode, struct file *file)
+{
+	return single_open(file, ftlcdc100_show_vblank, inode->i_private);
+}
 
-	switch (info->var.bits_per_pixel) {
-		case 1:
-			reg |= FTLCDC100_LCD_CONTROL_BPP1;
-			break;
+static const struct file_operations ftlcdc100_vblank_fops = {
+	.owner		= THIS_MODULE,
+	.open		= ftlcdc100_open_vblank,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
 
-		case 2:
-			reg |= FTLCDC100_LCD_CONTROL_BPP2;
-			break;
+/**
+ * ftlcdc100_debugfs_init - Create the debugfs directory of a device.
+ * @ftlcdc100: driver private data
+ * @name: directory name
+ *
+ * debugfs is only a debugging aid, so failures are ignored.
+ */
+static void ftlcdc100_debugfs_init(struct ftlcdc100 *ftlcdc100,
+	const char *name)
+{
+	ftlcdc100->debugfs = debugfs_create_dir(name, NULL);
+	if (!ftlcdc100->debugfs || IS_ERR(ftlcdc100->debugfs)) {
+		ftlcdc100->debugfs = NULL;
+		return;
+	}
 
-		case 4:
-			reg |= FTLCDC100_LCD_CONTROL_BPP4;
-			break;
+	debugfs_create_file("stats", S_IRUGO, ftlcdc100->debugfs, ftlcdc100,
+		&ftlcdc100_stats_fops);
+	debugfs_create_file("vblank", S_IRUGO, ftlcdc100->debugfs, ftlcdc100,
+		&ftlcdc100_vblank_fops);
+}
 
-		case 8:
-			reg |= FTLCDC100_LCD_CONTROL_BPP8;
-			break;
+/******************************************************************************
+ * sysfs attributes
+ *****************************************************************************/
+/*
+ * flip_displayed holds the sequence number of the flip on screen.  It is
+ * notified whenever that changes, so a producer can poll() it to learn that
+ * a buffer has been retired.
+ */
+static ssize_t ftlcdc100_show_flip_displayed(struct device *device,
+	struct device_attribute *attr, char *buf)
+{
+	struct fb_info *info = dev_get_drvdata(device);
+	struct ftlcdc100 *ftlcdc100 = info->par;
 
-		case 16:
-			reg |= FTLCDC100_LCD_CONTROL_BPP16;
-			break;
+	return snprintf(buf, PAGE_SIZE, "%u\n", ftlcdc100->flip_displayed);
+}
 
-		case 32:
-			reg |= FTLCDC100_LCD_CONTROL_BPP24;
-			break;
+/*
+ * write_flip selects whether write() renders into a back buffer and flips
+ * to it once a whole frame has been written.
+ */
+static ssize_t ftlcdc100_show_write_flip(struct device *device,
+	struct device_attribute *attr, char *buf)
+{
+	struct fb_info *info = dev_get_drvdata(device);
+	struct ftlcdc100 *ftlcdc100 = info->par;
 
-		default:
-			BUG();
-			break;
-	}
+	return snprintf(buf, PAGE_SIZE, "%d\n", ftlcdc100->write_flip);
+}
 
-	dev_dbg(dev, "  [LCD CONTROL] = %08x\n", reg);
-	iowrite32(reg, ftlcdc100->base + FTLCDC100_OFFSET_LCD_CONTROL);
+static ssize_t ftlcdc100_store_write_flip(struct device *device,
+	struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct fb_info *info = dev_get_drvdata(device);
+	struct ftlcdc100 *ftlcdc100 = info->par;
+	char *last;
 
-	return 0;
+	ftlcdc100->write_flip = !!simple_strtoul(buf, &last, 0);
+	return count;
 }
 
-/**
- * ftlcdc100_setcolreg - Optional function. Sets a color register.
- * @regno: Which register in the CLUT we are programming 
- * @red: The red value which can be up to 16 bits wide 
- * @green: The green value which can be up to 16 bits wide 
- * @blue:  The blue value which can be up to 16 bits wide.
- * @transp: If supported, the alpha value which can be up to 16 bits wide.
- * @info: frame buffer info structure
- * 
- * Set a single color register. The values supplied have a 16 bit
- * magnitude which needs to be scaled in this function for the hardware. 
- * Things to take into consideration are how many color registers, if
- * any, are supported with the current color visual. With truecolor mode
- * no color palettes are supported. Here a pseudo palette is created
- * which we store the value in pseudo_palette in struct fb_info. For
- * pseudocolor mode we have a limited color palette. To deal with this
- * we can program what color is displayed for a particular pixel value.
- * DirectColor is similar in that we can program each color field. If
- * we have a static colormap we don't need to implement this function. 
- * 
- * Returns negative errno on error, or zero on success.
+/*
+ * bandwidth_headroom is the percentage of the tighter bus bandwidth limit
+ * the current mode leaves unused; see ftlcdc100_bandwidth().
  */
-static int ftlcdc100_setcolreg(unsigned regno, unsigned red, unsigned green,
-	unsigned blue, unsigned transp, struct fb_info *info)
+static ssize_t ftlcdc100_show_bandwidth_headroom(struct device *device,
+	struct device_attribute *attr, char *buf)
 {
-	struct device *dev = info->device;
+	struct fb_info *info = dev_get_drvdata(device);
 	struct ftlcdc100 *ftlcdc100 = info->par;
-	u32 val;
+	struct fb_var_screeninfo scanout;
+	struct ftlcdc100_bandwidth bw;
 
-	dev_dbg(dev, "%s(%d, %d, %d, %d, %d)\n", __func__,
-		regno, red, green, blue, transp);
+	ftlcdc100_bandwidth(ftlcdc100_scanout_var(ftlcdc100, &info->var,
+			&scanout), ftlcdc100->clk_value_khz, &bw);
+	return snprintf(buf, PAGE_SIZE, "%d\n", bw.headroom);
+}
 
-	if (regno >= 256)  /* no. of hw registers */
-		return -EINVAL;
+/*
+ * underrun_advice becomes 1, and is notified, when underruns persist even
+ * with the FIFO fetching early.  Setting a new mode clears it.
+ */
+static ssize_t ftlcdc100_show_underrun_advice(struct device *device,
+	struct device_attribute *attr, char *buf)
+{
+	struct fb_info *info = dev_get_drvdata(device);
+	struct ftlcdc100 *ftlcdc100 = info->par;
 
-	/*
-	 * If grayscale is true, then we convert the RGB value
-	 * to grayscale no mater what visual we are using.
-	 */
-	if (info->var.grayscale) {
-		/* grayscale = 0.30*R + 0.59*G + 0.11*B */
-		red = green = blue = (red * 77 + green * 151 + blue * 28) >> 8;
-	}
+	return snprintf(buf, PAGE_SIZE, "%d\n", ftlcdc100->underrun_advice);
+}
 
-#define CNVT_TOHW(val,width) ((((val) << (width)) + 0x7FFF - (val)) >> 16)
-	red = CNVT_TOHW(red, info->var.red.length);
-	green = CNVT_TOHW(green, info->var.green.length);
-	blue = CNVT_TOHW(blue, info->var.blue.length);
-	transp = CNVT_TOHW(transp, info->var.transp.length);
-#undef CNVT_TOHW
+/*
+ * irq_stats holds the underrun, next base, vertical status and bus error
+ * interrupt counts.  It is notified when an underrun or bus error occurs.
+ */
+static ssize_t ftlcdc100_show_irq_stats(struct device *device,
+	struct device_attribute *attr, char *buf)
+{
+	struct fb_info *info = dev_get_drvdata(device);
+	struct ftlcdc100 *ftlcdc100 = info->par;
+	struct ftlcdc100_stats stats;
+	unsigned long flags;
 
-	switch (info->fix.visual) {
-	case FB_VISUAL_TRUECOLOR:
-		if (regno >= 16)
-			return -EINVAL;
-		/*
-		 * The contents of the pseudo_palette is in raw pixel format.
-		 * Ie, each entry can be written directly to the framebuffer
-		 * without any conversion.
-		 */
-	
-		val = (red << info->var.red.offset);
-		val |= (green << info->var.green.offset);
-		val |= (blue << info->var.blue.offset);
+	spin_lock_irqsave(&ftlcdc100->stats_lock, flags);
+	stats = ftlcdc100->stats;
+	spin_unlock_irqrestore(&ftlcdc100->stats_lock, flags);
 
-		ftlcdc100->pseudo_palette[regno] = val;
+	return snprintf(buf, PAGE_SIZE, "%lu %lu %lu %lu\n", stats.underrun,
+		stats.next_base, stats.vstatus, stats.bus_error);
+}
 
-		break;
+static struct device_attribute ftlcdc100_device_attrs[] = {
+	__ATTR(flip_displayed, S_IRUGO, ftlcdc100_show_flip_displayed, NULL),
+	__ATTR(write_flip, S_IRUGO | S_IWUSR, ftlcdc100_show_write_flip,
+		ftlcdc100_store_write_flip),
+	__ATTR(bandwidth_headroom, S_IRUGO, ftlcdc100_show_bandwidth_headroom,
+		NULL),
+	__ATTR(underrun_advice, S_IRUGO, ftlcdc100_show_underrun_advice, NULL),
+	__ATTR(irq_stats, S_IRUGO, ftlcdc100_show_irq_stats, NULL),
+};
 
-	case FB_VISUAL_STATIC_PSEUDOCOLOR:
-	case FB_VISUAL_PSEUDOCOLOR:
-		/* TODO set palette registers */
-		break;
+static int ftlcdc100_create_files(struct device *dev)
+{
+	int ret;
+	int i;
 
-	default:
-		return -EINVAL;
+	for (i = 0; i < ARRAY_SIZE(ftlcdc100_device_attrs); i++) {
+		ret = device_create_file(dev, &ftlcdc100_device_attrs[i]);
+		if (ret < 0)
+			goto err;
 	}
 
 	return 0;
-}
 
-/**
- * ftlcdc100_pan_display - NOT a required function. Pans the display.
- * @var: frame buffer variable screen structure
- * @info: frame buffer structure that represents a single frame buffer
- *
- * Pan (or wrap, depending on the `vmode' field) the display using the
- * `xoffset' and `yoffset' fields of the `var' structure.
- * If the values don't fit, return -EINVAL.
- *
- * Returns negative errno on error, or zero on success.
- */
-static int ftlcdc100_pan_display(struct fb_var_screeninfo *var,
-			       struct fb_info *info)
-{
-	struct device *dev = info->device;
-	struct ftlcdc100 *ftlcdc100 = info->par;
-	unsigned long dma_addr;
-	unsigned int value;
+err:
+	while (--i >= 0)
+		device_remove_file(dev, &ftlcdc100_device_attrs[i]);
 
-	dev_dbg(dev, "%s\n", __func__);
+	return ret;
+}
 
-	dma_addr = info->fix.smem_start + var->yoffset * info->fix.line_length;
-	value = FTLCDC100_LCD_FRAME_BASE(dma_addr);
+static void ftlcdc100_remove_files(struct device *dev)
+{
+	int i;
 
-	iowrite32(value, ftlcdc100->base + FTLCDC100_OFFSET_LCD_FRAME_BASE);
-	dev_dbg(dev, "  [LCD FRAME BASE] = %08x\n", value);
-	return 0;
+	for (i = 0; i < ARRAY_SIZE(ftlcdc100_device_attrs); i++)
+		device_remove_file(dev, &ftlcdc100_device_attrs[i]);
 }
 
 static struct fb_ops ftlcdc100_fb_ops = {
 	.owner		= THIS_MODULE,
+	.fb_open	= ftlcdc100_open,
+	.fb_read	= ftlcdc100_read,
+	.fb_write	= ftlcdc100_write,
 	.fb_check_var	= ftlcdc100_check_var,
 	.fb_set_par	= ftlcdc100_set_par,
 	.fb_setcolreg	= ftlcdc100_setcolreg,
+	.fb_setcmap	= ftlcdc100_setcmap,
 	.fb_pan_display	= ftlcdc100_pan_display,
+	.fb_ioctl	= ftlcdc100_ioctl,
 
-	/* These are generic software based fb functions */
-	.fb_fillrect	= cfb_fillrect,
-	.fb_copyarea	= cfb_copyarea,
-	.fb_imageblit	= cfb_imageblit,
+	.fb_fillrect	= ftlcdc100_fillrect,
+	.fb_copyarea	= ftlcdc100_copyarea,
+	.fb_imageblit	= ftlcdc100_imageblit,
+	.fb_cursor	= ftlcdc100_cursor,
 };
 
 /******************************************************************************
@@ -639,13 +3522,20 @@ static struct fb_ops ftlcdc100_fb_ops = {
 static int __devinit ftlcdc100_probe(struct platform_device *pdev)
 {
 	struct device *dev = &pdev->dev;
+	struct ftlcdc100_platform_data *pdata = dev->platform_data;
+	const struct fb_videomode *modes;
+	unsigned int num_modes;
+	const char *option;
 	struct ftlcdc100 *ftlcdc100;
 	struct resource *res;
 	struct fb_info *info;
 	struct clk *clk;
+	unsigned long size;
 	unsigned int reg;
+	unsigned int bpp;
 	int irq;
 	int ret;
+	int i;
 
 	dev_dbg(dev, "%s\n", __func__);
 	res = platform_get_resource(pdev, IORESOURCE_MEM, 0);
@@ -672,17 +3562,32 @@ static int __devinit ftlcdc100_probe(struct platform_device *pdev)
 	platform_set_drvdata(pdev, info);
 
 	ftlcdc100 = info->par;
+	ftlcdc100->info = info;
 
 	/*
 	 * Set up flags to indicate what sort of acceleration your
 	 * driver can provide (pan/wrap/copyarea/etc.) and whether it
 	 * is a module -- see FBINFO_* in include/linux/fb.h
 	 */
-	info->flags = FBINFO_DEFAULT;
+	info->flags = FBINFO_DEFAULT | FBINFO_HWACCEL_YPAN;
 
 	info->fbops = &ftlcdc100_fb_ops;
 	info->pseudo_palette = ftlcdc100->pseudo_palette;
 
+	init_waitqueue_head(&ftlcdc100->vsync_wait);
+	spin_lock_init(&ftlcdc100->flip_lock);
+	spin_lock_init(&ftlcdc100->stats_lock);
+	INIT_WORK(&ftlcdc100->flip_work, ftlcdc100_flip_work);
+	INIT_WORK(&ftlcdc100->underrun_work, ftlcdc100_underrun_work);
+	INIT_WORK(&ftlcdc100->stats_work, ftlcdc100_stats_work);
+	INIT_WORK(&ftlcdc100->zero_work, ftlcdc100_zero_work);
+
+	spin_lock_init(&ftlcdc100->damage_lock);
+	ftlcdc100->dirty_y1 = ~0;
+	ftlcdc100->defio = defio || convert;
+	ftlcdc100->convert = convert;
+	mutex_init(&ftlcdc100->flush_lock);
+
 	/*
 	 * Allocate colormap
 	 */
@@ -692,6 +3597,22 @@ static int __devinit ftlcdc100_probe(struct platform_device *pdev)
 		goto err_alloc_cmap;
 	}
 
+	/*
+	 * Allocate glyph cache
+	 */
+	ftlcdc100->glyph_spans = kmalloc(FTLCDC100_GLYPH_CACHE_SLOTS
+				* FTLCDC100_GLYPH_SLOT_WORDS * sizeof(u32),
+				GFP_KERNEL);
+	if (!ftlcdc100->glyph_spans) {
+		dev_err(dev, "Failed to allocate glyph cache\n");
+		ret = -ENOMEM;
+		goto err_alloc_glyph_cache;
+	}
+
+	for (i = 0; i < FTLCDC100_GLYPH_CACHE_SLOTS; i++)
+		ftlcdc100->glyph_slot[i].spans = ftlcdc100->glyph_spans
+					       + i * FTLCDC100_GLYPH_SLOT_WORDS;
+
 	/*
 	 * In fact, I don't know if LC_CLK is AHB clock on A320.  It is not
 	 * written in A320 data sheet.
@@ -725,11 +3646,75 @@ static int __devinit ftlcdc100_probe(struct platform_device *pdev)
 		goto err_ioremap;
 	}
 
+	ftlcdc100_load_reg_cache(ftlcdc100);
+
 	/*
-	 * Copy default parameters
+	 * The OSD font and attribute RAM are far above the control registers,
+	 * so older board files with a 4K resource do not map them.
 	 */
+	ftlcdc100->osd_mapped = res->end - res->start
+			     >= FTLCDC100_OFFSET_OSD_ATTRIBUTE
+			      + FTLCDC100_OSD_CELLS * 4;
+	if (!ftlcdc100->osd_mapped)
+		dev_info(dev, "memory resource too small for the OSD\n");
+
+	/*
+	 * Mode list, from the platform data or built in
+	 */
+	if (pdata && pdata->num_modes) {
+		modes = pdata->modes;
+		num_modes = pdata->num_modes;
+	} else {
+		modes = ftlcdc100_modedb;
+		num_modes = ARRAY_SIZE(ftlcdc100_modedb);
+	}
+
+	if (mode_option)
+		option = mode_option;
+	else if (pdata && pdata->mode_option)
+		option = pdata->mode_option;
+	else
+		option = FTLCDC100_DEFAULT_MODE;
+
+	INIT_LIST_HEAD(&info->modelist);
+	fb_videomode_to_modelist(modes, num_modes, &info->modelist);
+
 	info->fix = ftlcdc100_default_fix;
-	info->var = ftlcdc100_default_var;
+
+	if (fastboot && ftlcdc100_read_var(info, &info->var) == 0) {
+		dev_info(dev, "taking over %ux%u-%u mode from boot loader\n",
+			info->var.xres, info->var.yres,
+			info->var.bits_per_pixel);
+		ftlcdc100->fastboot = 1;
+	}
+
+	if (!ftlcdc100->fastboot
+	 && !fb_find_mode(&info->var, info, option, modes, num_modes, NULL,
+			FTLCDC100_DEFAULT_BPP)) {
+		dev_err(dev, "No usable video mode\n");
+		ret = -EINVAL;
+		goto err_find_mode;
+	}
+
+	info->var.yres_virtual = info->var.yres * max(vpages, 1);
+
+	/*
+	 * Reserve frame buffer memory, by default just enough for the virtual
+	 * screen of the initial mode.  Sizing it for the largest mode of the
+	 * list at 32bpp would take more than the whole consistent DMA area
+	 * on most boards.
+	 */
+	if (vram) {
+		size = PAGE_ALIGN(vram);
+	} else {
+		bpp = ftlcdc100->convert ? 32 : info->var.bits_per_pixel;
+		size = PAGE_ALIGN(info->var.xres * info->var.yres_virtual
+				  * DIV_ROUND_UP(bpp, 8));
+	}
+
+	ret = ftlcdc100_alloc_framebuffer(info, size);
+	if (ret < 0)
+		goto err_alloc_framebuffer;
 
 	ret = ftlcdc100_check_var(&info->var, info);
 	if (ret < 0) {
@@ -737,6 +3722,17 @@ static int __devinit ftlcdc100_probe(struct platform_device *pdev)
 		goto err_check_var;
 	}
 
+	if (ftlcdc100->fastboot)
+		ftlcdc100_copy_splash(info);
+
+	if (ftlcdc100->defio) {
+		/* copy damaged lines at most once per frame */
+		ftlcdc100->fbdefio.delay = DIV_ROUND_UP(HZ, 60);
+		ftlcdc100->fbdefio.deferred_io = ftlcdc100_deferred_io;
+		info->fbdefio = &ftlcdc100->fbdefio;
+		fb_deferred_io_init(info);
+	}
+
 	/*
 	 * Register interrupt handler
 	 */
@@ -752,9 +3748,15 @@ static int __devinit ftlcdc100_probe(struct platform_device *pdev)
 	 * Enable interrupts
 	 */
 	reg = FTLCDC100_LCD_INT_UNDERRUN
+	    | FTLCDC100_LCD_INT_NEXT_BASE
 	    | FTLCDC100_LCD_INT_BUS_ERROR;
 
-	iowrite32(reg, ftlcdc100->base + FTLCDC100_OFFSET_LCD_INT_ENABLE);
+	ftlcdc100_write_reg(ftlcdc100, FTLCDC100_OFFSET_LCD_INT_ENABLE, reg);
+
+	/*
+	 * OSD stays off until a client sets it up
+	 */
+	ftlcdc100_write_reg(ftlcdc100, FTLCDC100_OFFSET_OSD_SCALING_CONTROL, 0);
 
 	/*
 	 * Does a call to fb_set_par() before register_framebuffer needed?  This
@@ -776,23 +3778,46 @@ static int __devinit ftlcdc100_probe(struct platform_device *pdev)
 		goto err_register_info;
 	}
 
+	ret = ftlcdc100_create_files(info->dev);
+	if (ret < 0) {
+		dev_err(dev, "Failed to create sysfs attributes\n");
+		goto err_create_file;
+	}
+
+	ftlcdc100_debugfs_init(ftlcdc100, dev_name(dev));
+
+	/* deferred until now to get the picture up as early as possible */
+	if (ftlcdc100->fastboot)
+		schedule_work(&ftlcdc100->zero_work);
+
 	dev_info(dev, "fb%d: %s frame buffer device\n", info->node,
 		info->fix.id);
 	return 0;
 
+err_create_file:
+	unregister_framebuffer(info);
 err_register_info:
 	/* disable LCD HW */
-	iowrite32(0, ftlcdc100->base + FTLCDC100_OFFSET_LCD_CONTROL);
+	ftlcdc100_write_reg(ftlcdc100, FTLCDC100_OFFSET_LCD_CONTROL, 0);
 	free_irq(irq, info);
+	cancel_work_sync(&ftlcdc100->flip_work);
+	cancel_work_sync(&ftlcdc100->underrun_work);
+	cancel_work_sync(&ftlcdc100->stats_work);
 err_req_irq:
-	dma_free_writecombine(dev, info->fix.smem_len, info->screen_base,
-				(dma_addr_t )info->fix.smem_start);
+	if (ftlcdc100->defio)
+		fb_deferred_io_cleanup(info);
 err_check_var:
+	ftlcdc100_free_framebuffer(info);
+err_alloc_framebuffer:
+err_find_mode:
+	fb_destroy_modelist(&info->modelist);
 	iounmap(ftlcdc100->base);
 err_ioremap:
 err_req_mem_region:
 	clk_put(clk);
 err_clk_get:
+	kfree(ftlcdc100->glyph_spans);
+err_alloc_glyph_cache:
 	fb_dealloc_cmap(&info->cmap);
 err_alloc_cmap:
 	platform_set_drvdata(pdev, NULL);
@@ -806,26 +3831,34 @@ err_get_irq:
 static int __devexit ftlcdc100_remove(struct platform_device *pdev)
 {
 	struct fb_info *info;
-	struct device *dev;
 	struct ftlcdc100 *ftlcdc100;
 
 	info = platform_get_drvdata(pdev);
-	dev = info->device;
 	ftlcdc100 = info->par;
 
 	/* disable LCD HW */
-	iowrite32(0, ftlcdc100->base + FTLCDC100_OFFSET_LCD_INT_ENABLE);
-	iowrite32(0, ftlcdc100->base + FTLCDC100_OFFSET_LCD_CONTROL);
+	ftlcdc100_write_reg(ftlcdc100, FTLCDC100_OFFSET_LCD_INT_ENABLE, 0);
+	ftlcdc100_write_reg(ftlcdc100, FTLCDC100_OFFSET_LCD_CONTROL, 0);
 
-	unregister_framebuffer(info);
+	debugfs_remove_recursive(ftlcdc100->debugfs);
+	ftlcdc100_remove_files(info->dev);
 	free_irq(ftlcdc100->irq, info);
+	cancel_work_sync(&ftlcdc100->flip_work);
+	cancel_work_sync(&ftlcdc100->underrun_work);
+	cancel_work_sync(&ftlcdc100->stats_work);
+	cancel_work_sync(&ftlcdc100->zero_work);
+	unregister_framebuffer(info);
 
-	dma_free_writecombine(dev, info->fix.smem_len, info->screen_base,
-				(dma_addr_t )info->fix.smem_start);
+	if (ftlcdc100->defio)
+		fb_deferred_io_cleanup(info);
+
+	ftlcdc100_free_framebuffer(info);
+	fb_destroy_modelist(&info->modelist);
 
 	iounmap(ftlcdc100->base);
 
 	clk_put(ftlcdc100->clk);
+	kfree(ftlcdc100->glyph_spans);
 	fb_dealloc_cmap(&info->cmap);
 	platform_set_drvdata(pdev, NULL);
 	framebuffer_release(info);
@@ -834,9 +3867,115 @@ static int __devexit ftlcdc100_remove(struct platform_device *pdev)
 	return 0;
 }
 
+#ifdef CONFIG_PM
+/**
+ * ftlcdc100_finish_flips - Put the last staged frame on screen at once.
+ * @ftlcdc100: driver private data
+ *
+ * Called with flip_lock held and the interrupt masked, so that no commit
+ * or flip is left waiting for a vblank that will not come.
+ */
+static void ftlcdc100_finish_flips(struct ftlcdc100 *ftlcdc100)
+{
+	struct ftlcdc100_flip_entry *entry;
+	unsigned int last;
+
+	if (ftlcdc100->commit_done != ftlcdc100->commit_queued) {
+		ftlcdc100_commit_regs(ftlcdc100);
+	} else if (ftlcdc100->flip_count) {
+		last = (ftlcdc100->flip_head + ftlcdc100->flip_count - 1)
+		     % FTLCDC100_FLIP_QUEUE_LEN;
+		entry = &ftlcdc100->flip_queue[last];
+		ftlcdc100_write_reg(ftlcdc100,
+			FTLCDC100_OFFSET_LCD_FRAME_BASE, entry->frame_base);
+
+		ftlcdc100->flip_latch = *entry;
+		ftlcdc100->flip_latched = 1;
+		ftlcdc100->flip_count = 0;
+	}
+
+	if (ftlcdc100->flip_latched) {
+		ftlcdc100->flip_displayed = ftlcdc100->flip_latch.sequence;
+		ftlcdc100->flip_yoffset = ftlcdc100->flip_latch.yoffset;
+		ftlcdc100->flip_latched = 0;
+	}
+}
+
+/**
+ * ftlcdc100_suspend - Turn the LCD off and gate its clock.
+ * @pdev: platform device
+ * @state: target power state
+ *
+ * The register cache is left alone, so that resume can write it back.
+ *
+ * Returns zero.
+ */
+static int ftlcdc100_suspend(struct platform_device *pdev, pm_message_t state)
+{
+	struct fb_info *info = platform_get_drvdata(pdev);
+	struct ftlcdc100 *ftlcdc100 = info->par;
+	unsigned long flags;
+
+	acquire_console_sem();
+	fb_set_suspend(info, FBINFO_STATE_SUSPENDED);
+	release_console_sem();
+
+	iowrite32(0, ftlcdc100->base + FTLCDC100_OFFSET_LCD_INT_ENABLE);
+	synchronize_irq(ftlcdc100->irq);
+
+	spin_lock_irqsave(&ftlcdc100->flip_lock, flags);
+	ftlcdc100_finish_flips(ftlcdc100);
+	spin_unlock_irqrestore(&ftlcdc100->flip_lock, flags);
+
+	ftlcdc100->vsync_count++;
+	wake_up_interruptible(&ftlcdc100->vsync_wait);
+	schedule_work(&ftlcdc100->flip_work);
+
+	iowrite32(0, ftlcdc100->base + FTLCDC100_OFFSET_LCD_CONTROL);
+	clk_disable(ftlcdc100->clk);
+
+	return 0;
+}
+
+/**
+ * ftlcdc100_resume - Restore the registers from the cache.
+ * @pdev: platform device
+ *
+ * Returns zero.
+ */
+static int ftlcdc100_resume(struct platform_device *pdev)
+{
+	struct fb_info *info = platform_get_drvdata(pdev);
+	struct ftlcdc100 *ftlcdc100 = info->par;
+	unsigned int offset;
+	int i;
+
+	clk_enable(ftlcdc100->clk);
+
+	ftlcdc100_write_palette(ftlcdc100, 0, FTLCDC100_PALETTE_ENTRIES - 1);
+
+	for (i = 0; i < ARRAY_SIZE(ftlcdc100_restore_offsets); i++) {
+		offset = ftlcdc100_restore_offsets[i];
+		iowrite32(ftlcdc100->reg_cache[offset / 4],
+			ftlcdc100->base + offset);
+	}
+
+	acquire_console_sem();
+	fb_set_suspend(info, FBINFO_STATE_RUNNING);
+	release_console_sem();
+
+	return 0;
+}
+#else
+#define ftlcdc100_suspend	NULL
+#define ftlcdc100_resume	NULL
+#endif
+
 static struct platform_driver ftlcdc100_driver = {
 	.probe		= ftlcdc100_probe,
 	.remove		= __devexit_p(ftlcdc100_remove),
+	.suspend	= ftlcdc100_suspend,
+	.resume		= ftlcdc100_resume,
 
 	.driver		= {
 		.name	= "ftlcdc100",
@@ -22,6 +22,9 @@
 #ifndef __FTLCDC100_H
 #define __FTLCDC100_H
 
+#include <linux/types.h>
+#include <linux/ioctl.h>
+
 #define FTLCDC100_OFFSET_LCD_HTIMING		0x00
 #define FTLCDC100_OFFSET_LCD_VTIMING		0x04
 #define FTLCDC100_OFFSET_LCD_CLOCK_POLARITY	0x08
@@ -71,6 +74,13 @@
 #define FTLCDC100_LCD_FRAME_BASE_FRAME420_SIZE(x)	((x) & 0x3c)
 #define FTLCDC100_LCD_FRAME_BASE(x)			((x) & ~0x3f)
 
+/*
+ * In YUV420 mode, FRAME420_SIZE tells the controller the frame size so it
+ * can find the U and V planes behind the Y plane.
+ */
+#define FTLCDC100_LCD_FRAME_BASE_FRAME420_320X240	FTLCDC100_LCD_FRAME_BASE_FRAME420_SIZE(0x0 << 2)
+#define FTLCDC100_LCD_FRAME_BASE_FRAME420_640X480	FTLCDC100_LCD_FRAME_BASE_FRAME420_SIZE(0x1 << 2)
+
 /*
  * LCD Panel Pixel Parameters
  */
@@ -104,4 +114,224 @@
 #define FTLCDC100_LCD_INT_VSTATUS		(1 << 3)
 #define FTLCDC100_LCD_INT_BUS_ERROR		(1 << 4)
 
+/*
+ * OSD Scaling Control
+ */
+#define FTLCDC100_OSD_SCALING_CONTROL_ENABLE	(1 << 0)
+#define FTLCDC100_OSD_SCALING_CONTROL_VSCAL(x)	(((x) & 0x3) << 1)	/* cell height x (x + 1) */
+#define FTLCDC100_OSD_SCALING_CONTROL_HSCAL(x)	(((x) & 0x3) << 3)	/* cell width x (x + 1) */
+#define FTLCDC100_OSD_SCALING_CONTROL_VDIM(x)	(((x) & 0x1f) << 5)	/* rows - 1 */
+#define FTLCDC100_OSD_SCALING_CONTROL_HDIM(x)	(((x) & 0x3f) << 10)	/* columns - 1 */
+
+/*
+ * OSD Position Control
+ */
+#define FTLCDC100_OSD_POSITION_CONTROL_HPOS(x)	(((x) & 0x3ff) << 0)
+#define FTLCDC100_OSD_POSITION_CONTROL_VPOS(x)	(((x) & 0x3ff) << 10)
+
+/*
+ * OSD Foreground Color Control
+ * Four foreground colors, selected per cell by the attribute.
+ */
+#define FTLCDC100_OSD_FG_CONTROL_PAL(n, x)	(((x) & 0xff) << ((n) * 8))
+
+/*
+ * OSD Background Color Control
+ */
+#define FTLCDC100_OSD_BG_CONTROL_PAL(x)		(((x) & 0xff) << 0)
+#define FTLCDC100_OSD_BG_CONTROL_TRANS(x)	(((x) & 0x3) << 8)	/* 0: transparent ... 3: opaque */
+
+/*
+ * OSD Font RAM
+ * 256 glyphs of 12x16 pixels, one word per row, bit 11 is the leftmost pixel.
+ */
+#define FTLCDC100_OSD_GLYPHS		256
+#define FTLCDC100_OSD_GLYPH_WIDTH	12
+#define FTLCDC100_OSD_GLYPH_HEIGHT	16
+
+/*
+ * OSD Attribute RAM
+ * One word per cell, row by row.
+ */
+#define FTLCDC100_OSD_CELLS		512
+#define FTLCDC100_OSD_ATTRIBUTE_FG(x)	(((x) & 0x3) << 0)	/* foreground color 0..3 */
+#define FTLCDC100_OSD_ATTRIBUTE_FONT(x)	(((x) & 0xff) << 4)	/* glyph index */
+
+/*
+ * LCD Palette
+ * 256 entries of 16 bits, two per word: even entries in bits 15:0, odd
+ * entries in bits 31:16.
+ */
+#define FTLCDC100_PALETTE_ENTRIES	256
+#define FTLCDC100_PALETTE_R(x)		(((x) & 0x1f) << 10)
+#define FTLCDC100_PALETTE_G(x)		(((x) & 0x1f) << 5)
+#define FTLCDC100_PALETTE_B(x)		(((x) & 0x1f) << 0)
+
+/*
+ * Values of fb_var_screeninfo.nonstd that select YUV scanout
+ *
+ * YUV422 is packed, 16 bits per pixel.  YUV420 is planar: a full size Y
+ * plane followed by quarter size U and V planes, 12 bits per pixel on
+ * average.  line_length is the stride of the Y plane, and frames can only
+ * be panned as a whole (ypanstep == yres).
+ */
+#define FTLCDC100_NONSTD_YUV422		1
+#define FTLCDC100_NONSTD_YUV420		2
+
+/*
+ * Driver specific bit of fb_var_screeninfo.sync and fb_videomode.sync: the
+ * panel samples data on the falling edge of the pixel clock, so the clock
+ * is inverted (CLOCK_POLARITY ICK).
+ */
+#define FTLCDC100_SYNC_ICK		(1U << 31)
+
+/*
+ * Driver specific ioctls
+ */
+#define FTLCDC100_IOC_MAGIC	'f'
+
+/*
+ * Every flip queued with FTLCDC100IOC_QUEUE_FLIP gets a sequence number.
+ * The buffer handed over by a flip may be reused by the producer as soon as
+ * a later flip is on screen, i.e. once `displayed' is past its sequence.
+ */
+struct ftlcdc100_flip {
+	__u32 yoffset;		/* in:  first line of the buffer to show */
+	__u32 sequence;		/* out: sequence number of this flip */
+};
+
+/*
+ * Show a buffer outside the frame buffer, e.g. a video decoder's output
+ * surface, for zero copy playback.  It must hold a frame laid out like the
+ * frame buffer in the current mode and be aligned as FTLCDC100_LCD_FRAME_BASE()
+ * requires.  It must stay allocated until a later flip is on screen.
+ * Requires CAP_SYS_RAWIO.
+ */
+struct ftlcdc100_phys_flip {
+	__u32 phys;		/* in:  bus address of the buffer */
+	__u32 sequence;		/* out: sequence number of this flip */
+};
+
+/* flip status yoffset while a buffer queued by physical address is shown */
+#define FTLCDC100_FLIP_EXTERNAL		0xffffffff
+
+struct ftlcdc100_flip_status {
+	__u32 queued;		/* sequence number of the last queued flip */
+	__u32 displayed;	/* sequence number of the flip on screen */
+	__u32 yoffset;		/* yoffset of the buffer on screen */
+	__u32 pending;		/* number of flips waiting for vblank */
+};
+
+/*
+ * Describe one frame sized buffer of the virtual screen, so that a device
+ * driver (video decoder, camera) can be told to DMA straight into it and the
+ * result flipped to without a copy.  Not available in deferred I/O mode,
+ * where clients never see the scanout memory.
+ */
+struct ftlcdc100_buffer {
+	__u32 index;		/* in:  0 .. yres_virtual / yres - 1 */
+	__u32 count;		/* out: number of buffers */
+	__u32 yoffset;		/* out: yoffset to flip to */
+	__u32 offset;		/* out: mmap offset */
+	__u32 phys;		/* out: bus address */
+	__u32 size;		/* out: bytes, including U and V planes */
+	__u32 line_length;	/* out: bytes per line of the Y or RGB plane */
+};
+
+/*
+ * Mode changes are programmed during vertical blanking, and
+ * FBIOPUT_VSCREENINFO normally returns once that has happened.  After
+ * FTLCDC100IOC_SET_ASYNC_COMMIT with a non-zero argument it returns at
+ * once; the new mode counts as a flip, so wait for the `queued' sequence
+ * number of FTLCDC100IOC_GET_FLIP_STATUS with FTLCDC100IOC_WAIT_FLIP.
+ */
+
+/*
+ * Report lines y .. y + height - 1 as changed.  In deferred I/O mode they are
+ * copied to the screen with the next update, in addition to the pages that
+ * were written through mmap.  FTLCDC100IOC_QUEUE_FLIP copies the lines
+ * reported so far before it queues the flip.  Ignored otherwise.
+ */
+struct ftlcdc100_rect {
+	__u32 x;
+	__u32 y;
+	__u32 width;
+	__u32 height;
+};
+
+/*
+ * OSD overlay.  The OSD is a grid of character cells drawn by the controller
+ * on top of the frame buffer; nothing in the frame buffer is touched.
+ */
+struct ftlcdc100_osd_window {
+	__u32 enable;
+	__u32 x;		/* position of the top left corner in pixels */
+	__u32 y;
+	__u32 columns;		/* size in cells, columns * rows <= 512 */
+	__u32 rows;
+	__u32 hscale;		/* 0..3, cells are (scale + 1) times bigger */
+	__u32 vscale;
+};
+
+/*
+ * The hardware cursor is a one cell OSD window showing this glyph.  Load the
+ * pointer shape there with FTLCDC100IOC_OSD_SET_GLYPH.  The cursor and OSD
+ * text exclude each other: the cursor is refused while an OSD text window
+ * is enabled.
+ */
+#define FTLCDC100_OSD_CURSOR_GLYPH	(FTLCDC100_OSD_GLYPHS - 1)
+
+struct ftlcdc100_cursor {
+	__u32 enable;
+	__u32 x;		/* position of the top left corner in pixels */
+	__u32 y;
+};
+
+struct ftlcdc100_osd_glyph {
+	__u32 index;
+	__u16 bitmap[FTLCDC100_OSD_GLYPH_HEIGHT];
+};
+
+#define FTLCDC100_OSD_ATTRIBUTE_BATCH	64
+
+struct ftlcdc100_osd_attribute {
+	__u32 start;		/* first cell */
+	__u32 count;		/* <= FTLCDC100_OSD_ATTRIBUTE_BATCH */
+	__u32 attribute[FTLCDC100_OSD_ATTRIBUTE_BATCH];
+};
+
+struct ftlcdc100_osd_color {
+	__u32 fg;		/* FTLCDC100_OSD_FG_CONTROL_* */
+	__u32 bg;		/* FTLCDC100_OSD_BG_CONTROL_* */
+};
+
+#define FTLCDC100IOC_QUEUE_FLIP		_IOWR(FTLCDC100_IOC_MAGIC, 0, struct ftlcdc100_flip)
+#define FTLCDC100IOC_GET_FLIP_STATUS	_IOR(FTLCDC100_IOC_MAGIC, 1, struct ftlcdc100_flip_status)
+#define FTLCDC100IOC_WAIT_FLIP		_IOW(FTLCDC100_IOC_MAGIC, 2, __u32)
+#define FTLCDC100IOC_DAMAGE		_IOW(FTLCDC100_IOC_MAGIC, 3, struct ftlcdc100_rect)
+#define FTLCDC100IOC_OSD_SET_WINDOW	_IOW(FTLCDC100_IOC_MAGIC, 4, struct ftlcdc100_osd_window)
+#define FTLCDC100IOC_OSD_SET_GLYPH	_IOW(FTLCDC100_IOC_MAGIC, 5, struct ftlcdc100_osd_glyph)
+#define FTLCDC100IOC_OSD_SET_ATTRIBUTE	_IOW(FTLCDC100_IOC_MAGIC, 6, struct ftlcdc100_osd_attribute)
+#define FTLCDC100IOC_OSD_SET_COLOR	_IOW(FTLCDC100_IOC_MAGIC, 7, struct ftlcdc100_osd_color)
+#define FTLCDC100IOC_SET_CURSOR		_IOW(FTLCDC100_IOC_MAGIC, 8, struct ftlcdc100_cursor)
+#define FTLCDC100IOC_GET_BUFFER		_IOWR(FTLCDC100_IOC_MAGIC, 9, struct ftlcdc100_buffer)
+#define FTLCDC100IOC_QUEUE_PHYS_FLIP	_IOWR(FTLCDC100_IOC_MAGIC, 10, struct ftlcdc100_phys_flip)
+#define FTLCDC100IOC_SET_ASYNC_COMMIT	_IOW(FTLCDC100_IOC_MAGIC, 11, __u32)
+
+#ifdef __KERNEL__
+struct fb_videomode;
+
+/**
+ * struct ftlcdc100_platform_data - Board specific configuration
+ * @modes: modes the panel supports, or NULL for the built-in panel modes
+ * @num_modes: number of entries in @modes
+ * @mode_option: mode to start with in fb_find_mode() syntax, or NULL
+ */
+struct ftlcdc100_platform_data {
+	const struct fb_videomode *modes;
+	unsigned int num_modes;
+	const char *mode_option;
+};
+#endif	/* __KERNEL__ */
+
 #endif	/* __FTLCDC100_H */
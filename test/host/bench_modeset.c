@@ -0,0 +1,136 @@
+/*
+ * Host benchmark of the ftlcdc100 mode set path
+ *
+ * Times ftlcdc100_check_var() and ftlcdc100_set_par() for every panel mode
+ * and counts the register writes each mode set costs.  The figures are for
+ * the build host, so compare them between revisions, not with a board.
+ *
+ * Usage: bench_modeset [iterations]
+ */
+#include <time.h>
+
+#include "../../ftlcdc100.c"
+#include "mock.h"
+
+static const char *const bench_modes[] = {
+	"lq057q3dc02",
+	"a036qn01",
+	"pd035vx2",
+};
+
+#define BENCH_CLK_KHZ	100000
+
+static double now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void report(const char *mode, const char *what, double start,
+	unsigned long iterations, unsigned long writes)
+{
+	printf("%-12s %-22s %9.1f ns/op %6.1f writes/op\n", mode, what,
+		(now_ns() - start) / iterations,
+		(double)writes / iterations);
+}
+
+/*
+ * Alternate between 16 and 8 bits per pixel, so that every set_par()
+ * really changes the control register and rewrites the palette.
+ */
+static void bench_mode(const char *mode, unsigned long iterations)
+{
+	struct fb_var_screeninfo var[2];
+	struct ftlcdc100 *ftlcdc100;
+	struct fb_info *info;
+	unsigned long writes;
+	unsigned long i;
+	double start;
+
+	mock_reset(BENCH_CLK_KHZ);
+	mode_option = (char *)mode;
+	if (ftlcdc100_probe(&mock_pdev) < 0) {
+		printf("%-12s probe failed\n", mode);
+		return;
+	}
+
+	info = platform_get_drvdata(&mock_pdev);
+	ftlcdc100 = info->par;
+
+	var[0] = info->var;
+	var[1] = info->var;
+	var[1].bits_per_pixel = 8;
+
+	start = now_ns();
+	for (i = 0; i < iterations; i++) {
+		struct fb_var_screeninfo tmp = var[i & 1];
+
+		ftlcdc100_check_var(&tmp, info);
+	}
+	report(mode, "check_var", start, iterations, 0);
+
+	/* programmed at the next vblank, as with the LCD running */
+	mock_wait_hook = mock_vblank;
+	writes = 0;
+	start = now_ns();
+	for (i = 0; i < iterations; i++) {
+		mock_clear_writes();
+		info->var = var[i & 1];
+		ftlcdc100_check_var(&info->var, info);
+		ftlcdc100_set_par(info);
+		writes += mock_nr_writes();
+	}
+	report(mode, "mode set at vblank", start, iterations, writes);
+
+	/* programmed at once, as with the LCD off */
+	mock_wait_hook = NULL;
+	ftlcdc100_write_reg(ftlcdc100, FTLCDC100_OFFSET_LCD_CONTROL, 0);
+	writes = 0;
+	start = now_ns();
+	for (i = 0; i < iterations; i++) {
+		mock_clear_writes();
+		info->var = var[i & 1];
+		ftlcdc100_check_var(&info->var, info);
+		ftlcdc100_set_par(info);
+		writes += mock_nr_writes();
+		ftlcdc100_write_reg(ftlcdc100, FTLCDC100_OFFSET_LCD_CONTROL, 0);
+	}
+	report(mode, "mode set, LCD off", start, iterations, writes);
+
+	/* the same mode again must not touch the timings */
+	info->var = var[0];
+	ftlcdc100_check_var(&info->var, info);
+	ftlcdc100_set_par(info);
+	writes = 0;
+	start = now_ns();
+	for (i = 0; i < iterations; i++) {
+		mock_clear_writes();
+		ftlcdc100_set_par(info);
+		writes += mock_nr_writes();
+	}
+	report(mode, "set_par, no change", start, iterations, writes);
+
+	ftlcdc100_remove(&mock_pdev);
+	mode_option = NULL;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned long iterations = 100000;
+	unsigned int i;
+
+	if (argc > 1)
+		iterations = strtoul(argv[1], NULL, 0);
+	if (!iterations)
+		iterations = 1;
+
+	mock_verbose = getenv("MOCK_VERBOSE") != NULL;
+
+	printf("bus clock %u kHz, %lu iterations\n", BENCH_CLK_KHZ, iterations);
+	for (i = 0; i < ARRAY_SIZE(bench_modes); i++)
+		bench_mode(bench_modes[i], iterations);
+
+	return 0;
+}
@@ -0,0 +1,16 @@
+/*
+ * do_div() from <asm/div64.h>
+ */
+#ifndef SHIM_ASM_DIV64_H
+#define SHIM_ASM_DIV64_H
+
+#include "../kshim.h"
+
+#define do_div(n, base)						\
+	({							\
+		u32 __rem = (n) % (base);			\
+		(n) /= (base);					\
+		__rem;						\
+	})
+
+#endif /* SHIM_ASM_DIV64_H */
@@ -0,0 +1,385 @@
+/*
+ * Just enough of the kernel API to build ftlcdc100.c as a host program.
+ *
+ * The headers under linux/ and asm/ in this directory all pull in this
+ * file.  The functions declared here are implemented in mock.c.
+ */
+#ifndef KSHIM_H
+#define KSHIM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+
+/******************************************************************************
+ * types
+ *****************************************************************************/
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int32_t s32;
+typedef int64_t s64;
+typedef uint8_t __u8;
+typedef uint16_t __u16;
+typedef uint32_t __u32;
+typedef uint64_t __u64;
+typedef int32_t __s32;
+typedef unsigned long dma_addr_t;
+typedef unsigned int gfp_t;
+typedef int irqreturn_t;
+
+#define loff_t	long long
+#define ssize_t	long
+#define bool	_Bool
+#define true	1
+#define false	0
+
+/******************************************************************************
+ * annotations
+ *****************************************************************************/
+#define __user
+#define __iomem
+#define __init
+#define __exit
+#define __devinit
+#define __devexit
+#define __devinitdata
+#define __devexit_p(x)	x
+#define likely(x)	(x)
+#define unlikely(x)	(x)
+
+/******************************************************************************
+ * errno
+ *****************************************************************************/
+#define EPERM		1
+#define EIO		5
+#define ENXIO		6
+#define EAGAIN		11
+#define ENOMEM		12
+#define EFAULT		14
+#define EBUSY		16
+#define ENODEV		19
+#define EINVAL		22
+#define ENOTTY		25
+#define EFBIG		27
+#define ENOSPC		28
+#define ETIMEDOUT	110
+#define ERESTARTSYS	512
+#define ENOIOCTLCMD	515
+
+#define IS_ERR(p)	((unsigned long)(p) >= (unsigned long)-4095)
+#define PTR_ERR(p)	((long)(p))
+#define ERR_PTR(e)	((void *)(long)(e))
+
+#define BUG()		abort()
+#define BUG_ON(c)	do { if (c) abort(); } while (0)
+#define WARN_ON(c)	(c)
+
+/******************************************************************************
+ * kernel.h
+ *****************************************************************************/
+#define ARRAY_SIZE(a)		(sizeof(a) / sizeof((a)[0]))
+#define min(a, b)		((a) < (b) ? (a) : (b))
+#define max(a, b)		((a) > (b) ? (a) : (b))
+#define min_t(t, a, b)		((t)(a) < (t)(b) ? (t)(a) : (t)(b))
+#define max_t(t, a, b)		((t)(a) > (t)(b) ? (t)(a) : (t)(b))
+#define clamp(v, lo, hi)	min(max(v, lo), hi)
+#define clamp_t(t, v, lo, hi)	min_t(t, max_t(t, v, lo), hi)
+#define DIV_ROUND_UP(n, d)	(((n) + (d) - 1) / (d))
+#define DIV_ROUND_CLOSEST(x, d)	(((x) + ((d) / 2)) / (d))
+#define ALIGN(x, a)		(((x) + (a) - 1) & ~((a) - 1))
+#define IS_ALIGNED(x, a)	(((x) & ((a) - 1)) == 0)
+#define roundup(x, y)		((((x) + ((y) - 1)) / (y)) * (y))
+#define container_of(p, t, m)	((t *)((char *)(p) - offsetof(t, m)))
+
+#define PAGE_SIZE	4096UL
+#define PAGE_SHIFT	12
+#define PAGE_ALIGN(x)	ALIGN(x, PAGE_SIZE)
+
+#define printk		printf
+#define KERN_INFO	""
+#define KERN_ERR	""
+
+int printk_ratelimit(void);
+unsigned long simple_strtoul(const char *cp, char **endp, unsigned int base);
+void cond_resched(void);
+
+/* driver messages are only printed with MOCK_VERBOSE set */
+extern int mock_verbose;
+
+#define dev_printk_(d, ...) \
+	do { (void)(d); if (mock_verbose) printf(__VA_ARGS__); } while (0)
+#define dev_dbg(d, ...)		do { (void)(d); } while (0)
+#define dev_info(d, ...)	dev_printk_(d, __VA_ARGS__)
+#define dev_notice(d, ...)	dev_printk_(d, __VA_ARGS__)
+#define dev_warn(d, ...)	dev_printk_(d, __VA_ARGS__)
+#define dev_err(d, ...)		dev_printk_(d, __VA_ARGS__)
+
+/******************************************************************************
+ * list.h
+ *****************************************************************************/
+struct list_head {
+	struct list_head *next, *prev;
+};
+
+#define INIT_LIST_HEAD(l)	do { (l)->next = (l)->prev = (l); } while (0)
+#define list_for_each_entry(pos, head, member)				\
+	for (pos = container_of((head)->next, __typeof__(*pos), member); \
+	     &pos->member != (head);					\
+	     pos = container_of(pos->member.next, __typeof__(*pos), member))
+
+/******************************************************************************
+ * device model
+ *****************************************************************************/
+struct kobject {
+	int dummy;
+};
+
+struct device {
+	const char *name;
+	void *driver_data;
+	void *platform_data;
+	struct kobject kobj;
+};
+
+static inline const char *dev_name(struct device *dev)
+{
+	return dev->name;
+}
+
+static inline void *dev_get_drvdata(struct device *dev)
+{
+	return dev->driver_data;
+}
+
+enum kobject_action {
+	KOBJ_CHANGE,
+};
+
+int kobject_uevent_env(struct kobject *kobj, enum kobject_action action,
+	char *envp[]);
+
+struct device_attribute {
+	const char *name;
+	ssize_t (*show)(struct device *, struct device_attribute *, char *);
+	ssize_t (*store)(struct device *, struct device_attribute *,
+		const char *, size_t);
+};
+
+#define S_IRUGO	0444
+#define S_IWUSR	0200
+#define __ATTR(_n, _m, _s, _st)		{ #_n, _s, _st }
+#define DEVICE_ATTR(_n, _m, _s, _st) \
+	struct device_attribute dev_attr_##_n = __ATTR(_n, _m, _s, _st)
+
+int device_create_file(struct device *dev, struct device_attribute *attr);
+void device_remove_file(struct device *dev, struct device_attribute *attr);
+void sysfs_notify(struct kobject *kobj, const char *dir, const char *attr);
+
+#define CAP_SYS_RAWIO	17
+int capable(int cap);
+
+/******************************************************************************
+ * module
+ *****************************************************************************/
+struct module;
+
+#define THIS_MODULE			NULL
+#define module_init(x)	\
+	static int (*__module_init)(void) __attribute__((unused)) = x;
+#define module_exit(x)	\
+	static void (*__module_exit)(void) __attribute__((unused)) = x;
+#define MODULE_DESCRIPTION(x)
+#define MODULE_AUTHOR(x)
+#define MODULE_LICENSE(x)
+#define MODULE_PARM_DESC(a, b)
+#define module_param(n, t, p)
+#define module_param_named(n, v, t, p)
+
+/******************************************************************************
+ * platform device
+ *****************************************************************************/
+struct resource {
+	unsigned long start, end;
+	unsigned long flags;
+	const char *name;
+};
+
+#define IORESOURCE_MEM	0x200
+#define IORESOURCE_IRQ	0x400
+
+struct resource *request_mem_region(unsigned long start, unsigned long n,
+	const char *name);
+void release_mem_region(unsigned long start, unsigned long n);
+int release_resource(struct resource *res);
+
+struct platform_device {
+	const char *name;
+	int id;
+	struct device dev;
+	struct resource *resource;
+	unsigned int num_resources;
+};
+
+struct pm_message {
+	int event;
+};
+typedef struct pm_message pm_message_t;
+
+struct device_driver {
+	const char *name;
+	struct module *owner;
+};
+
+struct platform_driver {
+	int (*probe)(struct platform_device *);
+	int (*remove)(struct platform_device *);
+	int (*suspend)(struct platform_device *, pm_message_t);
+	int (*resume)(struct platform_device *);
+	struct device_driver driver;
+};
+
+struct resource *platform_get_resource(struct platform_device *pdev,
+	unsigned int type, unsigned int num);
+int platform_get_irq(struct platform_device *pdev, unsigned int num);
+int platform_driver_register(struct platform_driver *drv);
+void platform_driver_unregister(struct platform_driver *drv);
+
+static inline void platform_set_drvdata(struct platform_device *pdev,
+	void *data)
+{
+	pdev->dev.driver_data = data;
+}
+
+static inline void *platform_get_drvdata(struct platform_device *pdev)
+{
+	return pdev->dev.driver_data;
+}
+
+/******************************************************************************
+ * io, clk, irq, dma
+ *****************************************************************************/
+u32 ioread32(void __iomem *addr);
+void iowrite32(u32 val, void __iomem *addr);
+void __iomem *ioremap(unsigned long phys, unsigned long size);
+void iounmap(void __iomem *addr);
+void memcpy_fromio(void *to, const void __iomem *from, size_t n);
+
+struct clk;
+struct clk *clk_get(struct device *dev, const char *id);
+int clk_enable(struct clk *clk);
+void clk_disable(struct clk *clk);
+unsigned long clk_get_rate(struct clk *clk);
+void clk_put(struct clk *clk);
+
+#define IRQ_NONE	0
+#define IRQ_HANDLED	1
+#define IRQF_SHARED	0x80
+
+typedef irqreturn_t (*irq_handler_t)(int, void *);
+int request_irq(unsigned int irq, irq_handler_t handler, unsigned long flags,
+	const char *name, void *dev_id);
+void free_irq(unsigned int irq, void *dev_id);
+void synchronize_irq(unsigned int irq);
+
+#define GFP_KERNEL	0
+#define GFP_DMA		1
+
+void *dma_alloc_writecombine(struct device *dev, size_t size,
+	dma_addr_t *handle, gfp_t gfp);
+void dma_free_writecombine(struct device *dev, size_t size, void *cpu_addr,
+	dma_addr_t handle);
+
+void *kmalloc(size_t size, gfp_t flags);
+void *kzalloc(size_t size, gfp_t flags);
+void kfree(const void *p);
+void *vmalloc(unsigned long size);
+void vfree(const void *p);
+
+unsigned long copy_from_user(void *to, const void __user *from,
+	unsigned long n);
+unsigned long copy_to_user(void __user *to, const void *from,
+	unsigned long n);
+#define get_user(x, p)	((x) = *(p), 0)
+#define put_user(x, p)	(*(p) = (x), 0)
+
+#define _IOC(d, t, n, s) \
+	((unsigned int)(((unsigned int)(d) << 30) | ((s) << 16) | ((t) << 8) | (n)))
+#define _IO(t, n)		_IOC(0, t, n, 0)
+#define _IOR(t, n, ty)		_IOC(2, t, n, sizeof(ty))
+#define _IOW(t, n, ty)		_IOC(1, t, n, sizeof(ty))
+#define _IOWR(t, n, ty)		_IOC(3, t, n, sizeof(ty))
+
+void acquire_console_sem(void);
+void release_console_sem(void);
+
+/******************************************************************************
+ * locking, waiting and work
+ *
+ * Everything runs on one thread.  Work is run as soon as it is scheduled.
+ * A wait whose condition is false calls mock_wait(), which lets a test
+ * deliver an interrupt before the condition is checked again.
+ *****************************************************************************/
+typedef struct {
+	int dummy;
+} spinlock_t;
+
+#define spin_lock_init(l)		((void)(l))
+#define spin_lock(l)			((void)(l))
+#define spin_unlock(l)			((void)(l))
+#define spin_lock_irq(l)		((void)(l))
+#define spin_unlock_irq(l)		((void)(l))
+#define spin_lock_irqsave(l, f)		((void)(l), (f) = 0)
+#define spin_unlock_irqrestore(l, f)	((void)(l), (void)(f))
+
+struct mutex {
+	int dummy;
+};
+
+#define mutex_init(m)			((void)(m))
+#define mutex_lock(m)			((void)(m))
+#define mutex_unlock(m)			((void)(m))
+
+#define HZ	100
+
+typedef struct {
+	int dummy;
+} wait_queue_head_t;
+
+void init_waitqueue_head(wait_queue_head_t *wq);
+void wake_up(wait_queue_head_t *wq);
+void wake_up_interruptible(wait_queue_head_t *wq);
+void wake_up_all(wait_queue_head_t *wq);
+void mock_wait(wait_queue_head_t *wq);
+
+#define wait_event_interruptible_timeout(wq, cond, to)			\
+	({								\
+		long __to = (to);					\
+		if (!(cond))						\
+			mock_wait(&(wq));				\
+		(cond) ? (__to ? __to : 1) : 0;				\
+	})
+
+struct work_struct {
+	void (*func)(struct work_struct *);
+};
+
+#define INIT_WORK(w, f)	((w)->func = (f))
+int schedule_work(struct work_struct *work);
+int cancel_work_sync(struct work_struct *work);
+int flush_work(struct work_struct *work);
+void flush_scheduled_work(void);
+
+struct delayed_work {
+	struct work_struct work;
+};
+
+#define INIT_DELAYED_WORK(w, f)	((w)->work.func = (f))
+int schedule_delayed_work(struct delayed_work *work, unsigned long delay);
+int cancel_delayed_work_sync(struct delayed_work *work);
+
+#endif /* KSHIM_H */
@@ -0,0 +1,29 @@
+/*
+ * The parts of <linux/debugfs.h> used by ftlcdc100.c
+ */
+#ifndef SHIM_LINUX_DEBUGFS_H
+#define SHIM_LINUX_DEBUGFS_H
+
+#include "../kshim.h"
+
+struct dentry;
+struct file;
+
+struct inode {
+	void *i_private;
+};
+
+struct file_operations {
+	struct module *owner;
+	int (*open)(struct inode *, struct file *);
+	ssize_t (*read)(struct file *, char __user *, size_t, loff_t *);
+	loff_t (*llseek)(struct file *, loff_t, int);
+	int (*release)(struct inode *, struct file *);
+};
+
+struct dentry *debugfs_create_dir(const char *name, struct dentry *parent);
+struct dentry *debugfs_create_file(const char *name, int mode,
+	struct dentry *parent, void *data, const struct file_operations *fops);
+void debugfs_remove_recursive(struct dentry *dentry);
+
+#endif /* SHIM_LINUX_DEBUGFS_H */
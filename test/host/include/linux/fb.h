@@ -0,0 +1,254 @@
+/*
+ * The parts of <linux/fb.h> used by ftlcdc100.c
+ */
+#ifndef SHIM_LINUX_FB_H
+#define SHIM_LINUX_FB_H
+
+#include "../kshim.h"
+
+#define FB_TYPE_PACKED_PIXELS		0
+
+#define FB_VISUAL_MONO01		0
+#define FB_VISUAL_MONO10		1
+#define FB_VISUAL_TRUECOLOR		2
+#define FB_VISUAL_PSEUDOCOLOR		3
+#define FB_VISUAL_DIRECTCOLOR		4
+#define FB_VISUAL_STATIC_PSEUDOCOLOR	5
+
+#define FB_ACCEL_NONE			0
+
+#define FB_SYNC_HOR_HIGH_ACT		1
+#define FB_SYNC_VERT_HIGH_ACT		2
+
+#define FB_VMODE_NONINTERLACED		0
+#define FB_VMODE_YWRAP			256
+
+#define FB_ACTIVATE_NOW			0
+#define FB_ACTIVATE_MASK		15
+#define FB_ACTIVATE_VBL			16
+
+#define FBINFO_DEFAULT			0
+#define FBINFO_VIRTFB			0x0004
+#define FBINFO_READS_FAST		0x0080
+#define FBINFO_HWACCEL_COPYAREA		0x0100
+#define FBINFO_HWACCEL_FILLRECT		0x0200
+#define FBINFO_HWACCEL_IMAGEBLIT	0x0400
+#define FBINFO_HWACCEL_YPAN		0x2000
+#define FBINFO_HWACCEL_YWRAP		0x4000
+
+#define FBINFO_STATE_RUNNING		0
+#define FBINFO_STATE_SUSPENDED		1
+
+#define FBIO_CURSOR			0x4608
+#define FBIO_WAITFORVSYNC		_IOW('F', 0x20, __u32)
+
+#define ROP_COPY			0
+#define ROP_XOR				1
+
+#define FB_CUR_SETIMAGE			0x01
+#define FB_CUR_SETPOS			0x02
+#define FB_CUR_SETHOT			0x04
+#define FB_CUR_SETCMAP			0x08
+#define FB_CUR_SETSHAPE			0x10
+#define FB_CUR_SETSIZE			0x20
+#define FB_CUR_SETALL			0xff
+
+#define PICOS2KHZ(a)			(1000000000UL / (a))
+#define KHZ2PICOS(a)			(1000000000UL / (a))
+
+struct fb_bitfield {
+	__u32 offset;
+	__u32 length;
+	__u32 msb_right;
+};
+
+struct fb_fix_screeninfo {
+	char id[16];
+	unsigned long smem_start;
+	__u32 smem_len;
+	__u32 type;
+	__u32 type_aux;
+	__u32 visual;
+	__u16 xpanstep;
+	__u16 ypanstep;
+	__u16 ywrapstep;
+	__u32 line_length;
+	unsigned long mmio_start;
+	__u32 mmio_len;
+	__u32 accel;
+	__u16 reserved[3];
+};
+
+struct fb_var_screeninfo {
+	__u32 xres;
+	__u32 yres;
+	__u32 xres_virtual;
+	__u32 yres_virtual;
+	__u32 xoffset;
+	__u32 yoffset;
+	__u32 bits_per_pixel;
+	__u32 grayscale;
+	struct fb_bitfield red;
+	struct fb_bitfield green;
+	struct fb_bitfield blue;
+	struct fb_bitfield transp;
+	__u32 nonstd;
+	__u32 activate;
+	__u32 height;
+	__u32 width;
+	__u32 accel_flags;
+	__u32 pixclock;
+	__u32 left_margin;
+	__u32 right_margin;
+	__u32 upper_margin;
+	__u32 lower_margin;
+	__u32 hsync_len;
+	__u32 vsync_len;
+	__u32 sync;
+	__u32 vmode;
+	__u32 rotate;
+	__u32 reserved[5];
+};
+
+struct fb_cmap {
+	__u32 start;
+	__u32 len;
+	__u16 *red;
+	__u16 *green;
+	__u16 *blue;
+	__u16 *transp;
+};
+
+struct fb_fillrect {
+	__u32 dx, dy;
+	__u32 width, height;
+	__u32 color;
+	__u32 rop;
+};
+
+struct fb_copyarea {
+	__u32 dx, dy;
+	__u32 width, height;
+	__u32 sx, sy;
+};
+
+struct fb_image {
+	__u32 dx, dy;
+	__u32 width, height;
+	__u32 fg_color, bg_color;
+	__u8 depth;
+	const char *data;
+	struct fb_cmap cmap;
+};
+
+struct fbcurpos {
+	__u16 x, y;
+};
+
+struct fb_cursor {
+	__u16 set;
+	__u16 enable;
+	__u16 rop;
+	const char *mask;
+	struct fbcurpos hot;
+	struct fb_image image;
+};
+
+struct fb_videomode {
+	const char *name;
+	u32 refresh;
+	u32 xres;
+	u32 yres;
+	u32 pixclock;
+	u32 left_margin;
+	u32 right_margin;
+	u32 upper_margin;
+	u32 lower_margin;
+	u32 hsync_len;
+	u32 vsync_len;
+	u32 sync;
+	u32 vmode;
+	u32 flag;
+};
+
+struct page {
+	unsigned long index;
+	struct list_head lru;
+};
+
+struct fb_info;
+struct vm_area_struct;
+struct file;
+
+struct fb_deferred_io {
+	unsigned long delay;
+	void (*deferred_io)(struct fb_info *info, struct list_head *pagelist);
+};
+
+struct fb_ops {
+	struct module *owner;
+	int (*fb_open)(struct fb_info *, int);
+	int (*fb_release)(struct fb_info *, int);
+	ssize_t (*fb_read)(struct fb_info *, char __user *, size_t, loff_t *);
+	ssize_t (*fb_write)(struct fb_info *, const char __user *, size_t,
+		loff_t *);
+	int (*fb_check_var)(struct fb_var_screeninfo *, struct fb_info *);
+	int (*fb_set_par)(struct fb_info *);
+	int (*fb_setcolreg)(unsigned, unsigned, unsigned, unsigned, unsigned,
+		struct fb_info *);
+	int (*fb_setcmap)(struct fb_cmap *, struct fb_info *);
+	int (*fb_blank)(int, struct fb_info *);
+	int (*fb_pan_display)(struct fb_var_screeninfo *, struct fb_info *);
+	void (*fb_fillrect)(struct fb_info *, const struct fb_fillrect *);
+	void (*fb_copyarea)(struct fb_info *, const struct fb_copyarea *);
+	void (*fb_imageblit)(struct fb_info *, const struct fb_image *);
+	int (*fb_cursor)(struct fb_info *, struct fb_cursor *);
+	int (*fb_sync)(struct fb_info *);
+	int (*fb_ioctl)(struct fb_info *, unsigned int, unsigned long);
+	int (*fb_mmap)(struct fb_info *, struct vm_area_struct *);
+};
+
+struct fb_info {
+	int node;
+	int flags;
+	struct fb_var_screeninfo var;
+	struct fb_fix_screeninfo fix;
+	struct fb_cmap cmap;
+	struct list_head modelist;
+	struct fb_ops *fbops;
+	struct device *device;
+	struct device *dev;
+	char __iomem *screen_base;
+	unsigned long screen_size;
+	void *pseudo_palette;
+	u32 state;
+	void *par;
+	struct fb_deferred_io *fbdefio;
+	struct delayed_work deferred_work;
+};
+
+struct fb_info *framebuffer_alloc(size_t size, struct device *dev);
+void framebuffer_release(struct fb_info *info);
+int register_framebuffer(struct fb_info *info);
+int unregister_framebuffer(struct fb_info *info);
+void fb_set_suspend(struct fb_info *info, int state);
+
+int fb_alloc_cmap(struct fb_cmap *cmap, int len, int transp);
+void fb_dealloc_cmap(struct fb_cmap *cmap);
+
+int fb_find_mode(struct fb_var_screeninfo *var, struct fb_info *info,
+	const char *mode_option, const struct fb_videomode *db,
+	unsigned int dbsize, const struct fb_videomode *default_mode,
+	unsigned int default_bpp);
+void fb_videomode_to_modelist(const struct fb_videomode *modedb, int num,
+	struct list_head *head);
+void fb_destroy_modelist(struct list_head *head);
+
+void cfb_fillrect(struct fb_info *info, const struct fb_fillrect *rect);
+void cfb_copyarea(struct fb_info *info, const struct fb_copyarea *area);
+void cfb_imageblit(struct fb_info *info, const struct fb_image *image);
+
+void fb_deferred_io_init(struct fb_info *info);
+void fb_deferred_io_cleanup(struct fb_info *info);
+
+#endif /* SHIM_LINUX_FB_H */
@@ -0,0 +1,27 @@
+/*
+ * The parts of <linux/ktime.h> used by ftlcdc100.c
+ */
+#ifndef SHIM_LINUX_KTIME_H
+#define SHIM_LINUX_KTIME_H
+
+#include "../kshim.h"
+
+typedef struct {
+	s64 tv64;
+} ktime_t;
+
+ktime_t ktime_get(void);
+
+static inline ktime_t ktime_sub(ktime_t a, ktime_t b)
+{
+	ktime_t ret = { a.tv64 - b.tv64 };
+
+	return ret;
+}
+
+static inline s64 ktime_to_ns(ktime_t t)
+{
+	return t.tv64;
+}
+
+#endif /* SHIM_LINUX_KTIME_H */
@@ -0,0 +1,21 @@
+/*
+ * The parts of <linux/seq_file.h> used by ftlcdc100.c
+ */
+#ifndef SHIM_LINUX_SEQ_FILE_H
+#define SHIM_LINUX_SEQ_FILE_H
+
+#include "debugfs.h"
+
+struct seq_file {
+	void *private;
+};
+
+int seq_printf(struct seq_file *m, const char *fmt, ...);
+int single_open(struct file *file, int (*show)(struct seq_file *, void *),
+	void *data);
+ssize_t seq_read(struct file *file, char __user *buf, size_t size,
+	loff_t *ppos);
+loff_t seq_lseek(struct file *file, loff_t offset, int origin);
+int single_release(struct inode *inode, struct file *file);
+
+#endif /* SHIM_LINUX_SEQ_FILE_H */
@@ -0,0 +1,801 @@
+/*
+ * Register level mock of the FTLCDC100 and the kernel services the driver
+ * uses.  Register writes go to a plain array and are recorded in a log;
+ * reads of the interrupt status return what mock_irq() raised.
+ */
+#include <stdarg.h>
+#include <time.h>
+
+#include <linux/fb.h>
+#include <linux/ktime.h>
+#include <linux/seq_file.h>
+
+#include "../../ftlcdc100.h"
+#include "mock.h"
+
+int mock_verbose;
+void (*mock_wait_hook)(void);
+
+/* delayed work waiting for mock_run_delayed_work() */
+static int mock_delay_work;
+static struct delayed_work *mock_delayed;
+
+static u32 mock_regs[MOCK_REG_SIZE / 4];
+static u32 mock_int_status;
+
+static struct mock_write *mock_log;
+static unsigned int mock_log_len;
+static unsigned int mock_log_size;
+
+static irq_handler_t mock_handler;
+static void *mock_dev_id;
+static int mock_in_irq;
+
+static unsigned long mock_clk_rate;
+static int mock_clk_count;
+
+/*
+ * DMA buffers, so that bus addresses can be mapped back
+ */
+#define MOCK_DMA_BUFFERS	8
+
+static struct {
+	void *virt;
+	unsigned long phys;
+	size_t size;
+} mock_dma[MOCK_DMA_BUFFERS];
+
+static unsigned long mock_dma_next;
+
+/* bytes of the register window the driver has ioremap()ed */
+static unsigned long mock_regs_mapped;
+
+static struct resource mock_resources[] = {
+	{
+		.start	= MOCK_REG_BASE,
+		.end	= MOCK_REG_BASE + MOCK_REG_SIZE - 1,
+		.flags	= IORESOURCE_MEM,
+	}, {
+		.start	= MOCK_IRQ,
+		.end	= MOCK_IRQ,
+		.flags	= IORESOURCE_IRQ,
+	},
+};
+
+struct platform_device mock_pdev = {
+	.name		= "ftlcdc100",
+	.id		= 0,
+	.dev		= {
+		.name	= "ftlcdc100.0",
+	},
+	.resource	= mock_resources,
+	.num_resources	= ARRAY_SIZE(mock_resources),
+};
+
+/******************************************************************************
+ * test interface
+ *****************************************************************************/
+void mock_reset(unsigned long clk_khz)
+{
+	memset(mock_regs, 0, sizeof(mock_regs));
+	mock_int_status = 0;
+	mock_log_len = 0;
+	mock_wait_hook = NULL;
+	mock_delay_work = 0;
+	mock_delayed = NULL;
+	mock_clk_rate = clk_khz * 1000;
+	mock_clk_count = 0;
+	mock_dma_next = 0;
+	mock_pdev.dev.platform_data = NULL;
+	mock_resources[0].end = MOCK_REG_BASE + MOCK_REG_SIZE - 1;
+}
+
+void mock_set_mem_size(unsigned long size)
+{
+	mock_resources[0].end = MOCK_REG_BASE + size - 1;
+}
+
+u32 mock_reg(unsigned int offset)
+{
+	return mock_regs[offset / 4];
+}
+
+void mock_set_reg(unsigned int offset, u32 val)
+{
+	mock_regs[offset / 4] = val;
+}
+
+void mock_clear_writes(void)
+{
+	mock_log_len = 0;
+}
+
+unsigned int mock_nr_writes(void)
+{
+	return mock_log_len;
+}
+
+const struct mock_write *mock_get_write(unsigned int i)
+{
+	return i < mock_log_len ? &mock_log[i] : NULL;
+}
+
+int mock_last_write(unsigned int offset)
+{
+	int i;
+
+	for (i = mock_log_len - 1; i >= 0; i--)
+		if (mock_log[i].offset == offset)
+			return i;
+
+	return -1;
+}
+
+irqreturn_t mock_irq(u32 status)
+{
+	irqreturn_t ret;
+
+	if (!mock_handler)
+		return IRQ_NONE;
+
+	mock_int_status |= status;
+	mock_in_irq = 1;
+	ret = mock_handler(MOCK_IRQ, mock_dev_id);
+	mock_in_irq = 0;
+
+	return ret;
+}
+
+void mock_vblank(void)
+{
+	mock_irq(FTLCDC100_LCD_INT_NEXT_BASE);
+}
+
+int mock_clk_enabled(void)
+{
+	return mock_clk_count;
+}
+
+void *mock_dma_virt(unsigned long phys)
+{
+	int i;
+
+	for (i = 0; i < MOCK_DMA_BUFFERS; i++)
+		if (mock_dma[i].virt && phys >= mock_dma[i].phys
+		 && phys < mock_dma[i].phys + mock_dma[i].size)
+			return (char *)mock_dma[i].virt
+				+ (phys - mock_dma[i].phys);
+
+	return NULL;
+}
+
+/******************************************************************************
+ * io
+ *****************************************************************************/
+static int mock_offset(void __iomem *addr)
+{
+	char *p = addr;
+
+	if (p < (char *)mock_regs || p >= (char *)mock_regs + mock_regs_mapped) {
+		fprintf(stderr, "mock: access outside mapping at %p\n", addr);
+		abort();
+	}
+
+	return p - (char *)mock_regs;
+}
+
+u32 ioread32(void __iomem *addr)
+{
+	unsigned int offset = mock_offset(addr);
+
+	if (offset == FTLCDC100_OFFSET_LCD_INT_STATUS)
+		return mock_int_status;
+
+	return mock_regs[offset / 4];
+}
+
+void iowrite32(u32 val, void __iomem *addr)
+{
+	unsigned int offset = mock_offset(addr);
+
+	if (mock_log_len == mock_log_size) {
+		mock_log_size = mock_log_size ? mock_log_size * 2 : 1024;
+		mock_log = realloc(mock_log, mock_log_size * sizeof(*mock_log));
+		if (!mock_log)
+			abort();
+	}
+
+	mock_log[mock_log_len].offset = offset;
+	mock_log[mock_log_len].val = val;
+	mock_log[mock_log_len].in_irq = mock_in_irq;
+	mock_log_len++;
+
+	if (offset == FTLCDC100_OFFSET_LCD_INT_CLEAR)
+		mock_int_status &= ~val;
+	else
+		mock_regs[offset / 4] = val;
+}
+
+void __iomem *ioremap(unsigned long phys, unsigned long size)
+{
+	void *virt;
+
+	if (phys == MOCK_REG_BASE) {
+		mock_regs_mapped = min(size, (unsigned long)MOCK_REG_SIZE);
+		return mock_regs;
+	}
+
+	/* the boot loader's frame buffer */
+	virt = calloc(1, size);
+	if (virt && mock_dma_virt(phys))
+		memcpy(virt, mock_dma_virt(phys), size);
+
+	return virt;
+}
+
+void iounmap(void __iomem *addr)
+{
+	if (addr == (void *)mock_regs)
+		mock_regs_mapped = 0;
+	else
+		free(addr);
+}
+
+void memcpy_fromio(void *to, const void __iomem *from, size_t n)
+{
+	memcpy(to, from, n);
+}
+
+struct resource *request_mem_region(unsigned long start, unsigned long n,
+	const char *name)
+{
+	return &mock_resources[0];
+}
+
+void release_mem_region(unsigned long start, unsigned long n)
+{
+}
+
+int release_resource(struct resource *res)
+{
+	return 0;
+}
+
+/******************************************************************************
+ * dma and memory
+ *****************************************************************************/
+void *dma_alloc_writecombine(struct device *dev, size_t size,
+	dma_addr_t *handle, gfp_t gfp)
+{
+	int i;
+
+	for (i = 0; i < MOCK_DMA_BUFFERS; i++) {
+		if (mock_dma[i].virt)
+			continue;
+
+		mock_dma[i].virt = calloc(1, size);
+		if (!mock_dma[i].virt)
+			return NULL;
+
+		mock_dma[i].phys = MOCK_DMA_BASE + mock_dma_next;
+		mock_dma[i].size = size;
+		mock_dma_next += PAGE_ALIGN(size);
+
+		*handle = mock_dma[i].phys;
+		return mock_dma[i].virt;
+	}
+
+	return NULL;
+}
+
+void dma_free_writecombine(struct device *dev, size_t size, void *cpu_addr,
+	dma_addr_t handle)
+{
+	int i;
+
+	for (i = 0; i < MOCK_DMA_BUFFERS; i++) {
+		if (mock_dma[i].virt == cpu_addr) {
+			free(cpu_addr);
+			mock_dma[i].virt = NULL;
+			return;
+		}
+	}
+
+	fprintf(stderr, "mock: freeing unknown DMA buffer %p\n", cpu_addr);
+	abort();
+}
+
+void *kmalloc(size_t size, gfp_t flags)
+{
+	return malloc(size);
+}
+
+void *kzalloc(size_t size, gfp_t flags)
+{
+	return calloc(1, size);
+}
+
+void kfree(const void *p)
+{
+	free((void *)p);
+}
+
+void *vmalloc(unsigned long size)
+{
+	return malloc(size);
+}
+
+void vfree(const void *p)
+{
+	free((void *)p);
+}
+
+unsigned long copy_from_user(void *to, const void __user *from,
+	unsigned long n)
+{
+	memcpy(to, from, n);
+	return 0;
+}
+
+unsigned long copy_to_user(void __user *to, const void *from,
+	unsigned long n)
+{
+	memcpy(to, from, n);
+	return 0;
+}
+
+/******************************************************************************
+ * clk and irq
+ *****************************************************************************/
+static struct clk {
+	int dummy;
+} mock_clk;
+
+struct clk *clk_get(struct device *dev, const char *id)
+{
+	return &mock_clk;
+}
+
+int clk_enable(struct clk *clk)
+{
+	mock_clk_count++;
+	return 0;
+}
+
+void clk_disable(struct clk *clk)
+{
+	mock_clk_count--;
+}
+
+unsigned long clk_get_rate(struct clk *clk)
+{
+	return mock_clk_rate;
+}
+
+void clk_put(struct clk *clk)
+{
+}
+
+int request_irq(unsigned int irq, irq_handler_t handler, unsigned long flags,
+	const char *name, void *dev_id)
+{
+	mock_handler = handler;
+	mock_dev_id = dev_id;
+	return 0;
+}
+
+void free_irq(unsigned int irq, void *dev_id)
+{
+	mock_handler = NULL;
+	mock_dev_id = NULL;
+}
+
+void synchronize_irq(unsigned int irq)
+{
+}
+
+/******************************************************************************
+ * platform device
+ *****************************************************************************/
+struct resource *platform_get_resource(struct platform_device *pdev,
+	unsigned int type, unsigned int num)
+{
+	unsigned int i;
+
+	for (i = 0; i < pdev->num_resources; i++)
+		if ((pdev->resource[i].flags & type) && num-- == 0)
+			return &pdev->resource[i];
+
+	return NULL;
+}
+
+int platform_get_irq(struct platform_device *pdev, unsigned int num)
+{
+	struct resource *res = platform_get_resource(pdev, IORESOURCE_IRQ, num);
+
+	return res ? (int)res->start : -ENXIO;
+}
+
+int platform_driver_register(struct platform_driver *drv)
+{
+	return 0;
+}
+
+void platform_driver_unregister(struct platform_driver *drv)
+{
+}
+
+int device_create_file(struct device *dev, struct device_attribute *attr)
+{
+	return 0;
+}
+
+void device_remove_file(struct device *dev, struct device_attribute *attr)
+{
+}
+
+/* the device of the registered frame buffer */
+static struct device *mock_fb_dev;
+
+static void mock_check_kobj(struct kobject *kobj, const char *what)
+{
+	if (!mock_fb_dev || kobj != &mock_fb_dev->kobj) {
+		fprintf(stderr, "mock: %s on an unregistered device\n", what);
+		abort();
+	}
+}
+
+void sysfs_notify(struct kobject *kobj, const char *dir, const char *attr)
+{
+	mock_check_kobj(kobj, "sysfs_notify");
+}
+
+int kobject_uevent_env(struct kobject *kobj, enum kobject_action action,
+	char *envp[])
+{
+	mock_check_kobj(kobj, "kobject_uevent_env");
+	return 0;
+}
+
+int capable(int cap)
+{
+	return 1;
+}
+
+/******************************************************************************
+ * frame buffer core
+ *****************************************************************************/
+struct fb_info *framebuffer_alloc(size_t size, struct device *dev)
+{
+	struct fb_info *info;
+
+	info = calloc(1, sizeof(*info) + size);
+	if (!info)
+		return NULL;
+
+	info->par = info + 1;
+	info->device = dev;
+	return info;
+}
+
+void framebuffer_release(struct fb_info *info)
+{
+	free(info);
+}
+
+int register_framebuffer(struct fb_info *info)
+{
+	info->dev = calloc(1, sizeof(*info->dev));
+	if (!info->dev)
+		return -ENOMEM;
+
+	info->dev->name = "fb0";
+	info->dev->driver_data = info;
+	mock_fb_dev = info->dev;
+	return 0;
+}
+
+int unregister_framebuffer(struct fb_info *info)
+{
+	free(info->dev);
+	info->dev = NULL;
+	mock_fb_dev = NULL;
+	return 0;
+}
+
+void fb_set_suspend(struct fb_info *info, int state)
+{
+	info->state = state;
+}
+
+int fb_alloc_cmap(struct fb_cmap *cmap, int len, int transp)
+{
+	cmap->red = calloc(len, sizeof(u16));
+	cmap->green = calloc(len, sizeof(u16));
+	cmap->blue = calloc(len, sizeof(u16));
+	cmap->transp = transp ? calloc(len, sizeof(u16)) : NULL;
+	cmap->start = 0;
+	cmap->len = len;
+
+	if (!cmap->red || !cmap->green || !cmap->blue
+	 || (transp && !cmap->transp)) {
+		fb_dealloc_cmap(cmap);
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
+void fb_dealloc_cmap(struct fb_cmap *cmap)
+{
+	free(cmap->red);
+	free(cmap->green);
+	free(cmap->blue);
+	free(cmap->transp);
+	memset(cmap, 0, sizeof(*cmap));
+}
+
+static void mock_videomode_to_var(struct fb_var_screeninfo *var,
+	const struct fb_videomode *mode)
+{
+	var->xres = mode->xres;
+	var->yres = mode->yres;
+	var->xres_virtual = mode->xres;
+	var->yres_virtual = mode->yres;
+	var->xoffset = 0;
+	var->yoffset = 0;
+	var->pixclock = mode->pixclock;
+	var->left_margin = mode->left_margin;
+	var->right_margin = mode->right_margin;
+	var->upper_margin = mode->upper_margin;
+	var->lower_margin = mode->lower_margin;
+	var->hsync_len = mode->hsync_len;
+	var->vsync_len = mode->vsync_len;
+	var->sync = mode->sync;
+	var->vmode = mode->vmode;
+}
+
+/*
+ * Accepts "<name>[-<bpp>]" and "<xres>x<yres>[-<bpp>]"
+ */
+int fb_find_mode(struct fb_var_screeninfo *var, struct fb_info *info,
+	const char *mode_option, const struct fb_videomode *db,
+	unsigned int dbsize, const struct fb_videomode *default_mode,
+	unsigned int default_bpp)
+{
+	unsigned int xres = 0, yres = 0, bpp = default_bpp;
+	const char *dash;
+	size_t len;
+	unsigned int i;
+
+	if (!dbsize)
+		return 0;
+
+	dash = strchr(mode_option, '-');
+	len = dash ? (size_t)(dash - mode_option) : strlen(mode_option);
+	if (dash)
+		bpp = strtoul(dash + 1, NULL, 10);
+
+	sscanf(mode_option, "%ux%u", &xres, &yres);
+
+	memset(var, 0, sizeof(*var));
+	var->bits_per_pixel = bpp;
+
+	for (i = 0; i < dbsize; i++) {
+		if ((db[i].name && strlen(db[i].name) == len
+		  && !strncmp(db[i].name, mode_option, len))
+		 || (db[i].xres == xres && db[i].yres == yres)) {
+			mock_videomode_to_var(var, &db[i]);
+			return 1;
+		}
+	}
+
+	mock_videomode_to_var(var, default_mode ? default_mode : &db[0]);
+	return 4;
+}
+
+void fb_videomode_to_modelist(const struct fb_videomode *modedb, int num,
+	struct list_head *head)
+{
+}
+
+void fb_destroy_modelist(struct list_head *head)
+{
+}
+
+void cfb_fillrect(struct fb_info *info, const struct fb_fillrect *rect)
+{
+}
+
+void cfb_copyarea(struct fb_info *info, const struct fb_copyarea *area)
+{
+}
+
+void cfb_imageblit(struct fb_info *info, const struct fb_image *image)
+{
+}
+
+/* no page tracking: the worker only sees the damage the driver reports */
+static void mock_deferred_io_work(struct work_struct *work)
+{
+	struct fb_info *info = container_of(work, struct fb_info,
+					    deferred_work.work);
+	struct list_head pagelist = { &pagelist, &pagelist };
+
+	info->fbdefio->deferred_io(info, &pagelist);
+}
+
+void fb_deferred_io_init(struct fb_info *info)
+{
+	INIT_DELAYED_WORK(&info->deferred_work, mock_deferred_io_work);
+}
+
+void fb_deferred_io_cleanup(struct fb_info *info)
+{
+}
+
+void acquire_console_sem(void)
+{
+}
+
+void release_console_sem(void)
+{
+}
+
+/******************************************************************************
+ * waiting and work
+ *****************************************************************************/
+void init_waitqueue_head(wait_queue_head_t *wq)
+{
+}
+
+void wake_up(wait_queue_head_t *wq)
+{
+}
+
+void wake_up_interruptible(wait_queue_head_t *wq)
+{
+}
+
+void wake_up_all(wait_queue_head_t *wq)
+{
+}
+
+void mock_wait(wait_queue_head_t *wq)
+{
+	if (mock_wait_hook)
+		mock_wait_hook();
+}
+
+int schedule_work(struct work_struct *work)
+{
+	work->func(work);
+	return 1;
+}
+
+int cancel_work_sync(struct work_struct *work)
+{
+	return 0;
+}
+
+int flush_work(struct work_struct *work)
+{
+	return 0;
+}
+
+void flush_scheduled_work(void)
+{
+}
+
+int schedule_delayed_work(struct delayed_work *work, unsigned long delay)
+{
+	if (mock_delay_work) {
+		if (mock_delayed == work)
+			return 0;
+		mock_delayed = work;
+		return 1;
+	}
+
+	work->work.func(&work->work);
+	return 1;
+}
+
+int cancel_delayed_work_sync(struct delayed_work *work)
+{
+	if (mock_delayed != work)
+		return 0;
+
+	mock_delayed = NULL;
+	return 1;
+}
+
+void mock_hold_delayed_work(int hold)
+{
+	mock_delay_work = hold;
+}
+
+int mock_run_delayed_work(void)
+{
+	struct delayed_work *work = mock_delayed;
+
+	if (!work)
+		return 0;
+
+	mock_delayed = NULL;
+	work->work.func(&work->work);
+	return 1;
+}
+
+/******************************************************************************
+ * misc
+ *****************************************************************************/
+int printk_ratelimit(void)
+{
+	return 1;
+}
+
+unsigned long simple_strtoul(const char *cp, char **endp, unsigned int base)
+{
+	return strtoul(cp, endp, base);
+}
+
+void cond_resched(void)
+{
+}
+
+ktime_t ktime_get(void)
+{
+	struct timespec ts;
+	ktime_t ret;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	ret.tv64 = (s64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+	return ret;
+}
+
+struct dentry *debugfs_create_dir(const char *name, struct dentry *parent)
+{
+	return NULL;
+}
+
+struct dentry *debugfs_create_file(const char *name, int mode,
+	struct dentry *parent, void *data, const struct file_operations *fops)
+{
+	return NULL;
+}
+
+void debugfs_remove_recursive(struct dentry *dentry)
+{
+}
+
+int seq_printf(struct seq_file *m, const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	vprintf(fmt, ap);
+	va_end(ap);
+	return 0;
+}
+
+int single_open(struct file *file, int (*show)(struct seq_file *, void *),
+	void *data)
+{
+	return 0;
+}
+
+ssize_t seq_read(struct file *file, char __user *buf, size_t size,
+	loff_t *ppos)
+{
+	return 0;
+}
+
+loff_t seq_lseek(struct file *file, loff_t offset, int origin)
+{
+	return 0;
+}
+
+int single_release(struct inode *inode, struct file *file)
+{
+	return 0;
+}
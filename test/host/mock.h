@@ -0,0 +1,131 @@
+/*
+ * Register level mock of the FTLCDC100 and the kernel services the driver
+ * uses, for running ftlcdc100.c on the build host.
+ */
+#ifndef MOCK_H
+#define MOCK_H
+
+#include "kshim.h"
+
+#define MOCK_REG_BASE	0x90600000UL
+#define MOCK_REG_SIZE	0x10000
+#define MOCK_IRQ	25
+#define MOCK_DMA_BASE	0x02000000UL
+
+/*
+ * One register write as seen by the hardware
+ */
+struct mock_write {
+	unsigned int offset;
+	u32 val;
+	int in_irq;		/* written from the interrupt handler */
+};
+
+/*
+ * The device handed to the driver's probe function
+ */
+extern struct platform_device mock_pdev;
+
+/*
+ * Called by mock_wait() whenever the driver sleeps on a condition that
+ * is not yet true, e.g. mock_vblank() to let a staged mode set complete.
+ */
+extern void (*mock_wait_hook)(void);
+
+/**
+ * mock_reset - Forget all hardware state and recorded writes.
+ * @clk_khz: rate of the LCD controller clock
+ */
+void mock_reset(unsigned long clk_khz);
+
+/**
+ * mock_set_mem_size - Resize the register resource handed to probe.
+ * @size: bytes, e.g. 0x1000 as in older board files
+ *
+ * Accesses beyond what the driver maps abort the test.  Reset by
+ * mock_reset().
+ */
+void mock_set_mem_size(unsigned long size);
+
+/**
+ * mock_reg - Return the current value of a register.
+ * @offset: register offset
+ */
+u32 mock_reg(unsigned int offset);
+
+/**
+ * mock_set_reg - Preset a register, e.g. as a boot loader would leave it.
+ * @offset: register offset
+ * @val: value
+ *
+ * The write is not recorded.
+ */
+void mock_set_reg(unsigned int offset, u32 val);
+
+/**
+ * mock_clear_writes - Forget the recorded register writes.
+ */
+void mock_clear_writes(void);
+
+/**
+ * mock_nr_writes - Return the number of register writes since the last clear.
+ */
+unsigned int mock_nr_writes(void);
+
+/**
+ * mock_get_write - Return recorded write @i.
+ * @i: index, zero being the oldest
+ */
+const struct mock_write *mock_get_write(unsigned int i);
+
+/**
+ * mock_last_write - Find the most recent write to a register.
+ * @offset: register offset
+ *
+ * Returns the index of the write, or -1 if the register was not written.
+ */
+int mock_last_write(unsigned int offset);
+
+/**
+ * mock_irq - Raise interrupts and run the driver's handler.
+ * @status: FTLCDC100_LCD_INT_* bits to raise
+ *
+ * Returns the handler's return value, or IRQ_NONE with no handler.
+ */
+irqreturn_t mock_irq(u32 status);
+
+/**
+ * mock_vblank - Raise the next base interrupt of a vertical blank.
+ */
+void mock_vblank(void);
+
+/**
+ * mock_hold_delayed_work - Keep delayed work from running at once.
+ * @hold: non-zero to queue delayed work until mock_run_delayed_work()
+ *
+ * By default delayed work runs as soon as it is scheduled, e.g. the deferred
+ * I/O worker with every reported damage.  Reset by mock_reset().
+ */
+void mock_hold_delayed_work(int hold);
+
+/**
+ * mock_run_delayed_work - Run the delayed work held back, if any.
+ *
+ * Returns 1 if work was run, 0 if none was pending.
+ */
+int mock_run_delayed_work(void);
+
+/**
+ * mock_clk_enabled - Return the enable count of the LCD clock.
+ */
+int mock_clk_enabled(void);
+
+/**
+ * mock_dma_virt - Return the CPU address of DMA memory.
+ * @phys: bus address handed out by dma_alloc_writecombine()
+ *
+ * Returns NULL if @phys is not in an allocated buffer.
+ */
+void *mock_dma_virt(unsigned long phys);
+
+#endif /* MOCK_H */
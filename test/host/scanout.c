@@ -0,0 +1,675 @@
+/*
+ * Scanout emulator for the FTLCDC100
+ *
+ * Takes the controller's register state and a frame buffer image, renders
+ * the frame the panel would show and models the fetch bus clock by bus
+ * clock: the pixel clock from DIVNO, the blanking intervals from the
+ * timing registers, the FIFO and its request threshold, and other bus
+ * masters taking a configurable share of the bus.  Reports the bandwidth
+ * fetched per line and predicts underruns, so that panel timings and
+ * color depths can be qualified without a board.
+ *
+ * The register state is either what the driver's set_par programs for a
+ * mode (built against the mock, like the unit tests) or a register dump.
+ *
+ * Usage: scanout [options] <image>
+ *   -m <mode>     mode for the driver, e.g. a036qn01 or 320x240
+ *   -b <bpp>      color depth for the driver (default 16)
+ *   -c <kHz>      bus clock (default 100000)
+ *   -r <file>     read the registers from a dump instead
+ *   -d            print the registers as a dump and exit
+ *   -L <percent>  bus load from other masters (default 0)
+ *   -f <frames>   frames to simulate (default 1)
+ *   -s <seed>     seed for the bus load pattern (default 1)
+ *   -o <file>     write the rendered frame as PPM
+ *   -l <file>     write per line statistics as CSV
+ *
+ * A dump has one "<offset> <value>" pair of hex numbers per line, for the
+ * control registers and optionally the palette; '#' starts a comment.
+ * The exit status is 3 if underruns are predicted.
+ */
+#include <unistd.h>
+
+#include "../../ftlcdc100.c"
+#include "mock.h"
+
+/*
+ * Fetch model.  The FIFO holds FTLCDC100_FIFO_SLACK * 2 bytes.  A request
+ * is raised once FTLCDC100_FIFO_SLACK bytes or fewer are left, or half as
+ * much again with the FIFO threshold bit set, and is served as soon as the
+ * bus is free: after SCANOUT_ACCESS clocks the burst moves one word per
+ * clock, at most SCANOUT_BURST words and no more than fit.  Other masters
+ * do bursts of the same shape, and the LCD is granted the bus first when
+ * both are waiting.
+ */
+#define SCANOUT_FIFO_DEPTH	(FTLCDC100_FIFO_SLACK * 2)
+#define SCANOUT_BURST		16
+#define SCANOUT_ACCESS		4
+#define SCANOUT_LOAD_MAX	95
+
+struct scanout_timing {
+	unsigned int xres, yres;
+	unsigned int hsync, hbp, hfp;
+	unsigned int vsync, vbp, vfp;
+	unsigned int htotal, vtotal;
+	unsigned int divider;		/* bus clocks per pixel clock */
+	unsigned int bpp;		/* bits fetched per pixel */
+	unsigned int order;		/* FTLCDC100_LCD_CONTROL_*E?_*EP */
+	int bgr;
+	int fifo_threshold;
+};
+
+struct scanout_line {
+	unsigned long fetched;		/* bytes, summed over all frames */
+	unsigned long underruns;	/* pixels, summed over all frames */
+	long min_fifo;			/* bits, over all frames */
+	unsigned int max_wait;		/* bus clocks from request to data */
+};
+
+static u32 regs[FTLCDC100_OFFSET_PALETTE / 4 + FTLCDC100_PALETTE_ENTRIES / 2];
+
+static u32 reg(unsigned int offset)
+{
+	return regs[offset / 4];
+}
+
+/******************************************************************************
+ * register state
+ *****************************************************************************/
+/**
+ * driver_regs - Let the driver program a mode and take its registers.
+ * @mode: fb_find_mode() option, or NULL for the driver's default
+ * @bpp: color depth
+ * @clk_khz: bus clock
+ *
+ * Returns negative errno on error, or zero on success.
+ */
+static int driver_regs(const char *mode, unsigned int bpp,
+	unsigned long clk_khz)
+{
+	struct fb_info *info;
+	unsigned int i;
+	int ret;
+
+	mock_reset(clk_khz);
+	mode_option = (char *)mode;
+
+	/* the default pool only holds the initial mode at its depth */
+	vram = 1024 * 1024 * 4 * vpages;
+
+	ret = ftlcdc100_probe(&mock_pdev);
+	if (ret < 0) {
+		fprintf(stderr, "probe failed: %d\n", ret);
+		return ret;
+	}
+
+	info = platform_get_drvdata(&mock_pdev);
+	mock_wait_hook = mock_vblank;
+
+	if (info->var.bits_per_pixel != bpp) {
+		info->var.bits_per_pixel = bpp;
+		ret = ftlcdc100_check_var(&info->var, info);
+		if (ret == 0)
+			ret = ftlcdc100_set_par(info);
+		if (ret < 0)
+			fprintf(stderr, "%u bpp not accepted: %d\n", bpp, ret);
+	}
+
+	/* a gray ramp to show palette modes with */
+	if (ret == 0 && bpp <= 8) {
+		for (i = 0; i < 1U << bpp; i++) {
+			unsigned int v = i * 0xffff / ((1 << bpp) - 1);
+
+			ftlcdc100_setcolreg(i, v, v, v, 0, info);
+		}
+	}
+
+	for (i = 0; i < ARRAY_SIZE(regs); i++)
+		regs[i] = mock_reg(i * 4);
+
+	ftlcdc100_remove(&mock_pdev);
+	mode_option = NULL;
+	vram = 0;
+	return ret;
+}
+
+/**
+ * load_regs - Read a register dump.
+ * @name: file name
+ *
+ * Returns negative errno on error, or zero on success.
+ */
+static int load_regs(const char *name)
+{
+	unsigned long offset, val;
+	char line[256];
+	char *p;
+	FILE *f;
+	int n = 0;
+
+	f = fopen(name, "r");
+	if (!f) {
+		perror(name);
+		return -EIO;
+	}
+
+	while (fgets(line, sizeof(line), f)) {
+		n++;
+		p = strchr(line, '#');
+		if (p)
+			*p = '\0';
+		p = line + strspn(line, " \t\r\n");
+		if (!*p)
+			continue;
+
+		if (sscanf(p, "%lx %lx", &offset, &val) != 2
+		 || offset & 3 || offset / 4 >= ARRAY_SIZE(regs)) {
+			fprintf(stderr, "%s:%d: bad register line\n", name, n);
+			fclose(f);
+			return -EINVAL;
+		}
+
+		regs[offset / 4] = val;
+	}
+
+	fclose(f);
+	return 0;
+}
+
+static void dump_regs(void)
+{
+	static const struct {
+		unsigned int offset;
+		const char *name;
+	} names[] = {
+		{ FTLCDC100_OFFSET_LCD_HTIMING,		"HTIMING" },
+		{ FTLCDC100_OFFSET_LCD_VTIMING,		"VTIMING" },
+		{ FTLCDC100_OFFSET_LCD_CLOCK_POLARITY,	"CLOCK_POLARITY" },
+		{ FTLCDC100_OFFSET_LCD_FRAME_BASE,	"FRAME_BASE" },
+		{ FTLCDC100_OFFSET_LCD_INT_ENABLE,	"INT_ENABLE" },
+		{ FTLCDC100_OFFSET_LCD_CONTROL,		"CONTROL" },
+	};
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(names); i++)
+		printf("0x%02x 0x%08x	# %s\n", names[i].offset,
+			reg(names[i].offset), names[i].name);
+
+	if (((reg(FTLCDC100_OFFSET_LCD_CONTROL) >> 1) & 0x7) > 3)
+		return;
+
+	for (i = 0; i < FTLCDC100_PALETTE_ENTRIES / 2; i++)
+		printf("0x%03x 0x%08x\n", FTLCDC100_OFFSET_PALETTE + i * 4,
+			reg(FTLCDC100_OFFSET_PALETTE + i * 4));
+}
+
+/**
+ * decode_timing - Decode the timing and control registers.
+ * @t: returns the timing
+ *
+ * Returns negative errno on error, or zero on success.
+ */
+static int decode_timing(struct scanout_timing *t)
+{
+	static const unsigned int depths[] = { 1, 2, 4, 8, 16, 32 };
+	u32 htiming = reg(FTLCDC100_OFFSET_LCD_HTIMING);
+	u32 vtiming = reg(FTLCDC100_OFFSET_LCD_VTIMING);
+	u32 polarity = reg(FTLCDC100_OFFSET_LCD_CLOCK_POLARITY);
+	u32 control = reg(FTLCDC100_OFFSET_LCD_CONTROL);
+	unsigned int depth = (control >> 1) & 0x7;
+
+	t->xres = (((htiming >> 2) & 0x3f) + 1) * 16;
+	t->hsync = ((htiming >> 8) & 0xff) + 1;
+	t->hfp = ((htiming >> 16) & 0xff) + 1;
+	t->hbp = ((htiming >> 24) & 0xff) + 1;
+
+	t->yres = (vtiming & 0x3ff) + 1;
+	t->vsync = ((vtiming >> 10) & 0x3f) + 1;
+	t->vfp = (vtiming >> 16) & 0xff;
+	t->vbp = (vtiming >> 24) & 0xff;
+
+	t->htotal = t->hsync + t->hbp + t->xres + t->hfp;
+	t->vtotal = t->vsync + t->vbp + t->yres + t->vfp;
+	t->divider = FTLCDC100_LCD_CLOCK_POLARITY_DIVNO(polarity) + 1;
+
+	if (!(control & FTLCDC100_LCD_CONTROL_ENABLE))
+		fprintf(stderr, "warning: LCD not enabled in CONTROL\n");
+
+	if (control & FTLCDC100_LCD_CONTROL_YUV) {
+		fprintf(stderr, "YUV modes are not modelled\n");
+		return -EINVAL;
+	}
+
+	if (depth >= ARRAY_SIZE(depths)) {
+		fprintf(stderr, "reserved BPP field %u in CONTROL\n", depth);
+		return -EINVAL;
+	}
+
+	t->bpp = depths[depth];
+	t->order = control & (0x3 << 9);
+	t->bgr = !!(control & FTLCDC100_LCD_CONTROL_BGR);
+	t->fifo_threshold = !!(control & FTLCDC100_LCD_CONTROL_FIFO_THRESHOLD);
+
+	if (t->order == (0x3 << 9)) {
+		fprintf(stderr, "reserved endian field in CONTROL\n");
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+/******************************************************************************
+ * rendering
+ *****************************************************************************/
+static unsigned int expand(unsigned int v, unsigned int bits)
+{
+	return (v << (8 - bits)) | (v >> (2 * bits - 8));
+}
+
+/*
+ * Returns the value of pixel @n of the frame as fetched by the controller
+ */
+static u32 fetch_pixel(const struct scanout_timing *t, const u8 *mem,
+	unsigned long n)
+{
+	unsigned long bit = n * t->bpp;
+	const u8 *p = mem + bit / 32 * 4;
+	unsigned int shift = bit % 32;
+	u32 word;
+
+	word = p[0] | (p[1] << 8) | (p[2] << 16) | ((u32)p[3] << 24);
+
+	if (t->order == FTLCDC100_LCD_CONTROL_BEB_BEP)
+		word = (word >> 24) | ((word >> 8) & 0xff00)
+		     | ((word << 8) & 0xff0000) | (word << 24);
+
+	if (t->order != FTLCDC100_LCD_CONTROL_LEB_LEP)
+		shift = 32 - t->bpp - shift;
+
+	return t->bpp == 32 ? word : (word >> shift) & ((1 << t->bpp) - 1);
+}
+
+/*
+ * Converts a fetched pixel to 8 bit R, G, B.  With BGR set, red is in the
+ * most significant field, as the driver describes it in var.
+ */
+static void pixel_rgb(const struct scanout_timing *t, u32 v, u8 rgb[3])
+{
+	unsigned int hi, mid, lo;
+	u32 entry;
+
+	switch (t->bpp) {
+	case 32:
+		hi = (v >> 16) & 0xff;
+		mid = (v >> 8) & 0xff;
+		lo = v & 0xff;
+		break;
+
+	case 16:
+		hi = expand(v >> 11, 5);
+		mid = expand((v >> 5) & 0x3f, 6);
+		lo = expand(v & 0x1f, 5);
+		break;
+
+	default:
+		entry = reg(FTLCDC100_OFFSET_PALETTE + v / 2 * 4);
+		entry = v & 1 ? entry >> 16 : entry & 0xffff;
+		hi = expand((entry >> 10) & 0x1f, 5);
+		mid = expand((entry >> 5) & 0x1f, 5);
+		lo = expand(entry & 0x1f, 5);
+		break;
+	}
+
+	rgb[0] = t->bgr ? hi : lo;
+	rgb[1] = mid;
+	rgb[2] = t->bgr ? lo : hi;
+}
+
+/******************************************************************************
+ * fetch model
+ *****************************************************************************/
+static u32 random_state = 1;
+
+static u32 random_next(void)
+{
+	random_state ^= random_state << 13;
+	random_state ^= random_state >> 17;
+	random_state ^= random_state << 5;
+	return random_state;
+}
+
+struct scanout_bus {
+	unsigned long long now;		/* bus clock */
+	unsigned long long busy_until;	/* end of the current burst */
+	u32 other_chance;		/* per idle clock, of 2^32 */
+	unsigned long long other_busy;	/* clocks taken by other masters */
+
+	long fifo;			/* bits; negative after an underrun */
+	unsigned long long left;	/* bits of the frame not fetched yet */
+	int requesting;
+	unsigned long long request_time;
+	unsigned int incoming;		/* words of the LCD burst under way */
+	unsigned long long next_word;	/* when the next of them lands */
+
+	unsigned long fetched;		/* bytes in the current line */
+	unsigned int max_wait;		/* in the current line */
+};
+
+/*
+ * Advance the bus by one clock
+ */
+static void bus_clock(const struct scanout_timing *t, struct scanout_bus *b)
+{
+	long threshold = FTLCDC100_FIFO_SLACK * 8;
+	unsigned int space;
+	unsigned int wait;
+
+	if (t->fifo_threshold)
+		threshold += threshold / 2;
+
+	if (b->incoming && b->now >= b->next_word) {
+		b->fifo += 32;
+		b->fetched += 4;
+		b->incoming--;
+		b->next_word++;
+	}
+
+	if (!b->requesting && !b->incoming && b->left
+	 && b->fifo <= threshold) {
+		b->requesting = 1;
+		b->request_time = b->now;
+	}
+
+	if (b->now >= b->busy_until) {
+		if (b->requesting) {
+			space = (SCANOUT_FIFO_DEPTH * 8 - b->fifo) / 32;
+			space = min_t(unsigned int, space, SCANOUT_BURST);
+			space = min_t(unsigned long long, space,
+				DIV_ROUND_UP(b->left, 32));
+			space = max(space, 1U);
+
+			b->incoming = space;
+			b->next_word = b->now + SCANOUT_ACCESS;
+			b->busy_until = b->next_word + space;
+			b->left -= min_t(unsigned long long, b->left,
+				space * 32);
+			b->requesting = 0;
+
+			wait = b->next_word - b->request_time;
+			b->max_wait = max(b->max_wait, wait);
+		} else if (b->other_chance
+			&& random_next() < b->other_chance) {
+			b->busy_until = b->now + SCANOUT_ACCESS + SCANOUT_BURST;
+			b->other_busy += SCANOUT_ACCESS + SCANOUT_BURST;
+		}
+	}
+
+	b->now++;
+}
+
+/**
+ * scan_frame - Scan out one frame.
+ * @t: timing
+ * @mem: frame data
+ * @bus: bus state, carried over from the previous frame
+ * @lines: per line statistics, indexed by active line
+ * @marks: set for every pixel shown after an underrun
+ */
+static void scan_frame(const struct scanout_timing *t, const u8 *mem,
+	struct scanout_bus *bus, struct scanout_line *lines, u8 *marks)
+{
+	unsigned int x, y, i;
+	unsigned long n = 0;
+	long min_fifo;
+	int active_line;
+	int line;
+
+	/* fetching restarts from the frame base at every vsync */
+	bus->fifo = 0;
+	bus->left = (unsigned long long)t->xres * t->yres * t->bpp;
+	bus->requesting = 0;
+	bus->incoming = 0;
+
+	for (y = 0; y < t->vtotal; y++) {
+		line = y - (t->vsync + t->vbp);
+		active_line = line >= 0 && line < (int)t->yres;
+		bus->fetched = 0;
+		bus->max_wait = 0;
+		min_fifo = LONG_MAX;
+
+		for (x = 0; x < t->htotal; x++) {
+			for (i = 0; i < t->divider; i++)
+				bus_clock(t, bus);
+
+			if (!active_line || x < t->hsync + t->hbp
+			 || x >= t->hsync + t->hbp + t->xres)
+				continue;
+
+			bus->fifo -= t->bpp;
+			if (bus->fifo < 0) {
+				lines[line].underruns++;
+				marks[n] = 1;
+			}
+
+			/* at the end of the frame the FIFO just runs dry */
+			if (bus->left || bus->incoming)
+				min_fifo = min(min_fifo, bus->fifo);
+			n++;
+		}
+
+		if (!active_line)
+			continue;
+
+		lines[line].fetched += bus->fetched;
+		lines[line].min_fifo = min(lines[line].min_fifo, min_fifo);
+		lines[line].max_wait = max(lines[line].max_wait,
+					   bus->max_wait);
+	}
+}
+
+/******************************************************************************
+ * output
+ *****************************************************************************/
+static int write_ppm(const char *name, const struct scanout_timing *t,
+	const u8 *mem, const u8 *marks)
+{
+	static const u8 underrun_rgb[3] = { 0xff, 0x00, 0xff };
+	unsigned long n, pixels = (unsigned long)t->xres * t->yres;
+	u8 rgb[3];
+	FILE *f;
+
+	f = fopen(name, "wb");
+	if (!f) {
+		perror(name);
+		return -EIO;
+	}
+
+	fprintf(f, "P6\n%u %u\n255\n", t->xres, t->yres);
+	for (n = 0; n < pixels; n++) {
+		if (marks[n])
+			fwrite(underrun_rgb, 1, 3, f);
+		else {
+			pixel_rgb(t, fetch_pixel(t, mem, n), rgb);
+			fwrite(rgb, 1, 3, f);
+		}
+	}
+
+	if (fclose(f)) {
+		perror(name);
+		return -EIO;
+	}
+
+	return 0;
+}
+
+static int write_lines(const char *name, const struct scanout_timing *t,
+	const struct scanout_line *lines, unsigned int frames,
+	unsigned long clk_khz)
+{
+	/* bus clocks per line, in microseconds */
+	double line_us = (double)t->htotal * t->divider * 1000 / clk_khz;
+	unsigned int y;
+	FILE *f;
+
+	f = fopen(name, "w");
+	if (!f) {
+		perror(name);
+		return -EIO;
+	}
+
+	fprintf(f, "line,bytes,mb_per_s,min_fifo_bytes,max_wait_clocks,"
+		"underruns\n");
+	for (y = 0; y < t->yres; y++)
+		fprintf(f, "%u,%lu,%.2f,%ld,%u,%lu\n", y,
+			lines[y].fetched / frames,
+			lines[y].fetched / frames / line_us,
+			lines[y].min_fifo / 8, lines[y].max_wait,
+			lines[y].underruns);
+
+	if (fclose(f)) {
+		perror(name);
+		return -EIO;
+	}
+
+	return 0;
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "usage: scanout [-m mode] [-b bpp] [-c kHz] "
+		"[-r dump] [-d] [-L load] [-f frames] [-s seed] "
+		"[-o frame.ppm] [-l lines.csv] <image>\n");
+	exit(2);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *mode = NULL, *dump = NULL, *ppm = NULL, *csv = NULL;
+	unsigned long clk_khz = 100000;
+	unsigned int bpp = 16, load = 0, frames = 1;
+	struct scanout_timing t;
+	struct scanout_bus bus;
+	struct scanout_line *lines;
+	unsigned long frame_bytes, underruns = 0, bad_lines = 0;
+	unsigned long peak = 0;
+	unsigned int max_wait = 0;
+	long min_fifo = LONG_MAX;
+	double pixclk_khz, line_us, frame_us;
+	int print_dump = 0;
+	u8 *mem, *marks;
+	unsigned int y, f;
+	FILE *img;
+	size_t got;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "m:b:c:r:dL:f:s:o:l:")) != -1) {
+		switch (opt) {
+		case 'm': mode = optarg; break;
+		case 'b': bpp = strtoul(optarg, NULL, 0); break;
+		case 'c': clk_khz = strtoul(optarg, NULL, 0); break;
+		case 'r': dump = optarg; break;
+		case 'd': print_dump = 1; break;
+		case 'L': load = strtoul(optarg, NULL, 0); break;
+		case 'f': frames = strtoul(optarg, NULL, 0); break;
+		case 's': random_state = strtoul(optarg, NULL, 0); break;
+		case 'o': ppm = optarg; break;
+		case 'l': csv = optarg; break;
+		default: usage();
+		}
+	}
+
+	if (!clk_khz || !frames || !random_state)
+		usage();
+	if (load > SCANOUT_LOAD_MAX) {
+		fprintf(stderr, "bus load capped at %u%%\n", SCANOUT_LOAD_MAX);
+		load = SCANOUT_LOAD_MAX;
+	}
+
+	if (dump ? load_regs(dump) : driver_regs(mode, bpp, clk_khz))
+		return 1;
+
+	if (print_dump) {
+		dump_regs();
+		return 0;
+	}
+
+	if (optind != argc - 1)
+		usage();
+
+	if (decode_timing(&t))
+		return 1;
+
+	frame_bytes = (unsigned long)t.xres * t.yres * t.bpp / 8;
+	mem = calloc(1, frame_bytes + 4);
+	marks = calloc(1, (size_t)t.xres * t.yres);
+	lines = calloc(t.yres, sizeof(*lines));
+	if (!mem || !marks || !lines) {
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+
+	img = fopen(argv[optind], "rb");
+	if (!img) {
+		perror(argv[optind]);
+		return 1;
+	}
+	got = fread(mem, 1, frame_bytes, img);
+	fclose(img);
+	if (got < frame_bytes)
+		fprintf(stderr, "warning: image has %zu of %lu bytes, "
+			"rest shown black\n", got, frame_bytes);
+
+	for (y = 0; y < t.yres; y++)
+		lines[y].min_fifo = LONG_MAX;
+
+	/*
+	 * Other masters start a burst on an idle clock with a chance that
+	 * makes them take about load percent of the bus
+	 */
+	memset(&bus, 0, sizeof(bus));
+	if (load)
+		bus.other_chance = (u32)(4294967295.0 * load / (100 - load)
+				/ (SCANOUT_ACCESS + SCANOUT_BURST));
+
+	for (f = 0; f < frames; f++)
+		scan_frame(&t, mem, &bus, lines, marks);
+
+	pixclk_khz = (double)clk_khz / t.divider;
+	line_us = t.htotal * 1000.0 / pixclk_khz;
+	frame_us = line_us * t.vtotal;
+
+	for (y = 0; y < t.yres; y++) {
+		peak = max(peak, lines[y].fetched / frames);
+		underruns += lines[y].underruns;
+		bad_lines += lines[y].underruns != 0;
+		min_fifo = min(min_fifo, lines[y].min_fifo);
+		max_wait = max(max_wait, lines[y].max_wait);
+	}
+
+	printf("mode:        %ux%u, %u bpp, %u x %u total\n",
+		t.xres, t.yres, t.bpp, t.htotal, t.vtotal);
+	printf("pixel clock: %.1f kHz (bus %lu kHz / %u), %.2f Hz refresh\n",
+		pixclk_khz, clk_khz, t.divider, 1e6 / frame_us);
+	printf("bus load:    %u%% requested, %.1f%% by other masters\n",
+		load, 100.0 * bus.other_busy / max(bus.now, 1ULL));
+	printf("fetch:       %.2f MB/s average, %.2f MB/s peak line\n",
+		frame_bytes / frame_us, peak / line_us);
+	printf("FIFO:        %u bytes, request at %u, threshold bit %s\n",
+		SCANOUT_FIFO_DEPTH,
+		FTLCDC100_FIFO_SLACK * (t.fifo_threshold ? 3 : 2) / 2,
+		t.fifo_threshold ? "set" : "clear");
+	printf("worst case:  %ld bytes left in FIFO, %u clocks to data\n",
+		min_fifo / 8, max_wait);
+	if (underruns)
+		printf("underrun:    %lu pixels on %lu lines over %u frames\n",
+			underruns, bad_lines, frames);
+	else
+		printf("underrun:    none predicted\n");
+
+	if (ppm && write_ppm(ppm, &t, mem, marks))
+		return 1;
+	if (csv && write_lines(csv, &t, lines, frames, clk_khz))
+		return 1;
+
+	return underruns ? 3 : 0;
+}
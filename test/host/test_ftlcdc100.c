@@ -0,0 +1,1630 @@
+/*
+ * Host unit tests for ftlcdc100.c
+ *
+ * The driver is built into this program against the shim in include/ and
+ * the register mock in mock.c.  Every panel mode is probed at the bus
+ * clocks we ship with and the programmed registers are compared with
+ * known good values, so timing regressions show up before a board does.
+ */
+#include "../../ftlcdc100.c"
+#include "mock.h"
+
+static int failures;
+static const char *current;
+
+#define CHECK(cond)							\
+	do {								\
+		if (!(cond)) {						\
+			printf("FAIL %s: %s:%d: %s\n", current,		\
+				__FILE__, __LINE__, #cond);		\
+			failures++;					\
+		}							\
+	} while (0)
+
+#define CHECK_REG(offset, expected)					\
+	do {								\
+		u32 __val = mock_reg(offset);				\
+		if (__val != (u32)(expected)) {				\
+			printf("FAIL %s: %s:%d: %s = %08x, "		\
+				"expected %08x\n", current, __FILE__,	\
+				__LINE__, #offset, __val,		\
+				(u32)(expected));			\
+			failures++;					\
+		}							\
+	} while (0)
+
+/*
+ * Register values the driver programs today, recorded from a run and
+ * reviewed against the panel data sheets.  HTIMING, the pulse widths and
+ * back porches are the data sheet timings as they are.  The vertical front
+ * porch in VTIMING is not: the clock solver stretches lower_margin to keep
+ * the refresh rate with the divided bus clock, so those bits are whatever
+ * the solver settles on and have to be updated here when it is changed on
+ * purpose.  The pd035vx2 latches data on the falling edge of the pixel
+ * clock, so its CLOCK_POLARITY has ICK set.
+ */
+struct panel_case {
+	const char *mode;
+	unsigned long clk_khz;
+	u32 htiming;
+	u32 vtiming;
+	u32 clock_polarity;
+	u32 control;
+};
+
+static const struct panel_case panel_cases[] = {
+	{ "lq057q3dc02", 100000, 0x1010104c, 0x071100ef, 0x00009010, 0x00000929 },
+	{ "a036qn01",    100000, 0x2b05144c, 0x0b0a08ef, 0x00009810, 0x00000929 },
+	{ "pd035vx2",    100000, 0x2b13639c, 0x101549df, 0x0000b810, 0x00000929 },
+	{ "lq057q3dc02",  66000, 0x1010104c, 0x071700ef, 0x0000900a, 0x00000929 },
+	{ "a036qn01",     66000, 0x2b05144c, 0x0b1008ef, 0x0000980a, 0x00000929 },
+	{ "pd035vx2",     66000, 0x2b13639c, 0x101f49df, 0x0000b80a, 0x00000929 },
+};
+
+static struct fb_info *probe_panel(const struct panel_case *pc)
+{
+	mock_reset(pc->clk_khz);
+	mode_option = (char *)pc->mode;
+
+	if (ftlcdc100_probe(&mock_pdev) < 0)
+		return NULL;
+
+	return platform_get_drvdata(&mock_pdev);
+}
+
+static void remove_panel(void)
+{
+	ftlcdc100_remove(&mock_pdev);
+	mode_option = NULL;
+}
+
+/*
+ * Returns the number of writes to @offset since the last clear, and how
+ * many of them came from the interrupt handler in *@in_irq.
+ */
+static unsigned int count_writes(unsigned int offset, unsigned int *in_irq)
+{
+	const struct mock_write *w;
+	unsigned int n = 0;
+	unsigned int i;
+
+	if (in_irq)
+		*in_irq = 0;
+
+	for (i = 0; i < mock_nr_writes(); i++) {
+		w = mock_get_write(i);
+		if (w->offset != offset)
+			continue;
+		n++;
+		if (in_irq && w->in_irq)
+			(*in_irq)++;
+	}
+
+	return n;
+}
+
+/******************************************************************************
+ * tests
+ *****************************************************************************/
+static void test_probe(const struct panel_case *pc, struct fb_info *info)
+{
+	CHECK_REG(FTLCDC100_OFFSET_LCD_HTIMING, pc->htiming);
+	CHECK_REG(FTLCDC100_OFFSET_LCD_VTIMING, pc->vtiming);
+	CHECK_REG(FTLCDC100_OFFSET_LCD_CLOCK_POLARITY, pc->clock_polarity);
+	CHECK_REG(FTLCDC100_OFFSET_LCD_CONTROL, pc->control);
+	CHECK_REG(FTLCDC100_OFFSET_LCD_FRAME_BASE, info->fix.smem_start);
+	CHECK_REG(FTLCDC100_OFFSET_LCD_INT_ENABLE,
+		FTLCDC100_LCD_INT_UNDERRUN | FTLCDC100_LCD_INT_NEXT_BASE
+		| FTLCDC100_LCD_INT_BUS_ERROR);
+	CHECK_REG(FTLCDC100_OFFSET_OSD_SCALING_CONTROL, 0);
+	CHECK(info->var.yres_virtual == info->var.yres * vpages);
+	CHECK(info->fix.line_length == info->var.xres * 2);
+
+	/* the default pool holds just the initial mode */
+	CHECK(info->fix.smem_len
+		== PAGE_ALIGN(info->fix.line_length * info->var.yres_virtual));
+}
+
+static void test_check_var(const struct panel_case *pc, struct fb_info *info)
+{
+	struct fb_var_screeninfo var;
+	struct fb_var_screeninfo again;
+
+	/* the current mode is accepted unchanged */
+	var = info->var;
+	CHECK(ftlcdc100_check_var(&var, info) == 0);
+	CHECK(memcmp(&var, &info->var, sizeof(var)) == 0);
+
+	/* and so is what check_var made of it, with no further change */
+	again = var;
+	CHECK(ftlcdc100_check_var(&again, info) == 0);
+	CHECK(memcmp(&again, &var, sizeof(var)) == 0);
+
+	var = info->var;
+	var.pixclock = 0;
+	CHECK(ftlcdc100_check_var(&var, info) == -EINVAL);
+
+	var = info->var;
+	var.xres = 1040;
+	var.xres_virtual = 1040;
+	CHECK(ftlcdc100_check_var(&var, info) == -EINVAL);
+
+	var = info->var;
+	var.hsync_len = 257;
+	CHECK(ftlcdc100_check_var(&var, info) == -EINVAL);
+
+	var = info->var;
+	var.vsync_len = 65;
+	CHECK(ftlcdc100_check_var(&var, info) == -EINVAL);
+
+	/* a pixel clock faster than the bus is slowed down */
+	var = info->var;
+	var.pixclock = KHZ2PICOS(pc->clk_khz * 2);
+	CHECK(ftlcdc100_check_var(&var, info) == 0);
+	CHECK(PICOS2KHZ(var.pixclock) <= pc->clk_khz);
+
+	/* the virtual screen must fit in the reserved memory */
+	var = info->var;
+	var.yres_virtual = info->fix.smem_len / info->fix.line_length + 1;
+	CHECK(ftlcdc100_check_var(&var, info) < 0);
+}
+
+static void test_set_par_unchanged(const struct panel_case *pc,
+	struct fb_info *info)
+{
+	mock_clear_writes();
+	CHECK(ftlcdc100_set_par(info) == 0);
+
+	/* rewriting the timings disturbs the panel */
+	CHECK(count_writes(FTLCDC100_OFFSET_LCD_HTIMING, NULL) == 0);
+	CHECK(count_writes(FTLCDC100_OFFSET_LCD_VTIMING, NULL) == 0);
+	CHECK(count_writes(FTLCDC100_OFFSET_LCD_CLOCK_POLARITY, NULL) == 0);
+	CHECK(count_writes(FTLCDC100_OFFSET_LCD_CONTROL, NULL) == 0);
+	CHECK_REG(FTLCDC100_OFFSET_LCD_HTIMING, pc->htiming);
+}
+
+static void test_set_par_vblank(const struct panel_case *pc,
+	struct fb_info *info)
+{
+	unsigned int in_irq;
+
+	info->var.bits_per_pixel = 8;
+	CHECK(ftlcdc100_check_var(&info->var, info) == 0);
+
+	/* a running LCD is reprogrammed from the next vblank interrupt */
+	mock_wait_hook = mock_vblank;
+	mock_clear_writes();
+	CHECK(ftlcdc100_set_par(info) == 0);
+	mock_wait_hook = NULL;
+
+	CHECK(count_writes(FTLCDC100_OFFSET_LCD_CONTROL, &in_irq) == 1);
+	CHECK(in_irq == 1);
+	CHECK(count_writes(FTLCDC100_OFFSET_LCD_FRAME_BASE, NULL) == 1);
+	CHECK(in_irq == 1);
+	CHECK_REG(FTLCDC100_OFFSET_LCD_CONTROL,
+		(pc->control & ~(0x7 << 1)) | FTLCDC100_LCD_CONTROL_BPP8);
+	CHECK(info->fix.visual == FB_VISUAL_PSEUDOCOLOR);
+	CHECK(info->fix.line_length == info->var.xres);
+
+	/* without a vblank the set is written when the wait times out */
+	info->var.bits_per_pixel = 16;
+	CHECK(ftlcdc100_check_var(&info->var, info) == 0);
+	mock_clear_writes();
+	CHECK(ftlcdc100_set_par(info) == 0);
+	CHECK(count_writes(FTLCDC100_OFFSET_LCD_CONTROL, &in_irq) == 1);
+	CHECK(in_irq == 0);
+	CHECK_REG(FTLCDC100_OFFSET_LCD_CONTROL, pc->control);
+}
+
+static void test_set_par_idle(const struct panel_case *pc,
+	struct fb_info *info)
+{
+	struct ftlcdc100 *ftlcdc100 = info->par;
+	unsigned int in_irq;
+
+	ftlcdc100_write_reg(ftlcdc100, FTLCDC100_OFFSET_LCD_CONTROL, 0);
+
+	/* with the LCD off there is no vblank to wait for */
+	mock_clear_writes();
+	CHECK(ftlcdc100_set_par(info) == 0);
+	CHECK(count_writes(FTLCDC100_OFFSET_LCD_CONTROL, &in_irq) == 1);
+	CHECK(in_irq == 0);
+	CHECK_REG(FTLCDC100_OFFSET_LCD_CONTROL, pc->control);
+	CHECK(ftlcdc100->commit_done == ftlcdc100->commit_queued);
+}
+
+static void test_mode_switch(const struct panel_case *pc,
+	struct fb_info *info)
+{
+	const struct fb_videomode *mode;
+	struct fb_var_screeninfo var;
+	unsigned int i;
+	u32 ick;
+
+	/* the pixel clock polarity follows the mode selected at run time */
+	for (i = 0; i < ARRAY_SIZE(ftlcdc100_modedb); i++) {
+		mode = &ftlcdc100_modedb[i];
+
+		var = info->var;
+		var.xres = var.xres_virtual = mode->xres;
+		var.yres = var.yres_virtual = mode->yres;
+		var.pixclock = mode->pixclock;
+		var.left_margin = mode->left_margin;
+		var.right_margin = mode->right_margin;
+		var.upper_margin = mode->upper_margin;
+		var.lower_margin = mode->lower_margin;
+		var.hsync_len = mode->hsync_len;
+		var.vsync_len = mode->vsync_len;
+		var.sync = mode->sync;
+		var.yoffset = 0;
+
+		/* larger than the memory reserved for this panel */
+		if (ftlcdc100_check_var(&var, info) < 0)
+			continue;
+
+		info->var = var;
+		mock_wait_hook = mock_vblank;
+		CHECK(ftlcdc100_set_par(info) == 0);
+		mock_wait_hook = NULL;
+
+		ick = mock_reg(FTLCDC100_OFFSET_LCD_CLOCK_POLARITY)
+		    & FTLCDC100_LCD_CLOCK_POLARITY_ICK;
+		CHECK(!ick == !(mode->sync & FTLCDC100_SYNC_ICK));
+	}
+}
+
+static void test_setcmap(const struct panel_case *pc, struct fb_info *info)
+{
+	struct ftlcdc100 *ftlcdc100 = info->par;
+	u16 red[256], green[256], blue[256];
+	struct fb_cmap cmap;
+	unsigned int i;
+
+	for (i = 0; i < 256; i++) {
+		red[i] = i << 8;
+		green[i] = 0;
+		blue[i] = 0xffff - (i << 8);
+	}
+
+	cmap.start = 0;
+	cmap.len = 256;
+	cmap.red = red;
+	cmap.green = green;
+	cmap.blue = blue;
+	cmap.transp = NULL;
+
+	/* the fb core loads all 256 entries after a mode set, even at 2bpp */
+	info->var.bits_per_pixel = 2;
+	CHECK(ftlcdc100_check_var(&info->var, info) == 0);
+	mock_wait_hook = mock_vblank;
+	CHECK(ftlcdc100_set_par(info) == 0);
+	mock_wait_hook = NULL;
+
+	CHECK(info->fix.line_length == info->var.xres / 4);
+
+	mock_clear_writes();
+	CHECK(ftlcdc100_setcmap(&cmap, info) == 0);
+	CHECK(mock_nr_writes() == 2);
+	for (i = 0; i < 4; i++)
+		CHECK(ftlcdc100->palette[i] == ftlcdc100_palette_entry(info,
+			red[i], green[i], blue[i]));
+	CHECK(ftlcdc100->palette[4] == 0);
+
+	/* and in truecolor modes, of which only 16 reach fbcon */
+	info->var.bits_per_pixel = 16;
+	CHECK(ftlcdc100_check_var(&info->var, info) == 0);
+	mock_wait_hook = mock_vblank;
+	CHECK(ftlcdc100_set_par(info) == 0);
+	mock_wait_hook = NULL;
+	CHECK(ftlcdc100_setcmap(&cmap, info) == 0);
+	CHECK(ftlcdc100->pseudo_palette[15] == 0x101d);
+}
+
+static void test_pan(const struct panel_case *pc, struct fb_info *info)
+{
+	struct ftlcdc100 *ftlcdc100 = info->par;
+	struct fb_var_screeninfo var = info->var;
+
+	var.yoffset = info->var.yres;
+	mock_clear_writes();
+	CHECK(ftlcdc100_pan_display(&var, info) == 0);
+	CHECK(count_writes(FTLCDC100_OFFSET_LCD_FRAME_BASE, NULL) == 1);
+	CHECK_REG(FTLCDC100_OFFSET_LCD_FRAME_BASE,
+		info->fix.smem_start + var.yoffset * info->fix.line_length);
+	CHECK(count_writes(FTLCDC100_OFFSET_LCD_HTIMING, NULL) == 0);
+
+	/* the new base is on screen after the next vblank */
+	mock_vblank();
+	CHECK(ftlcdc100->flip_displayed == ftlcdc100->flip_queued);
+	CHECK(ftlcdc100->flip_yoffset == var.yoffset);
+
+	/* past the end of the virtual screen */
+	var.yoffset = info->var.yres_virtual - info->var.yres + 1;
+	CHECK(ftlcdc100_pan_display(&var, info) == -EINVAL);
+
+	var.yoffset = 0;
+	CHECK(ftlcdc100_pan_display(&var, info) == 0);
+	CHECK_REG(FTLCDC100_OFFSET_LCD_FRAME_BASE, info->fix.smem_start);
+}
+
+static void test_pan_packed(const struct panel_case *pc,
+	struct fb_info *info)
+{
+	struct fb_var_screeninfo var;
+
+	/* a 1bpp line is xres / 8 bytes, FRAME_BASE must stay aligned */
+	info->var.bits_per_pixel = 1;
+	CHECK(ftlcdc100_check_var(&info->var, info) == 0);
+	mock_wait_hook = mock_vblank;
+	CHECK(ftlcdc100_set_par(info) == 0);
+	mock_wait_hook = NULL;
+	CHECK(info->fix.line_length == info->var.xres / 8);
+	CHECK(info->fix.ypanstep * info->fix.line_length % 64 == 0);
+	CHECK(info->fix.ypanstep > 1);
+
+	var = info->var;
+	var.yoffset = info->fix.ypanstep - 1;
+	CHECK(ftlcdc100_pan_display(&var, info) == -EINVAL);
+
+	var.yoffset = info->fix.ypanstep;
+	CHECK(ftlcdc100_pan_display(&var, info) == 0);
+	CHECK_REG(FTLCDC100_OFFSET_LCD_FRAME_BASE, info->fix.smem_start
+		+ var.yoffset * info->fix.line_length);
+
+	/* 16bpp lines are long enough for any offset */
+	info->var.bits_per_pixel = 16;
+	CHECK(ftlcdc100_check_var(&info->var, info) == 0);
+	mock_wait_hook = mock_vblank;
+	CHECK(ftlcdc100_set_par(info) == 0);
+	mock_wait_hook = NULL;
+	CHECK(info->fix.ypanstep == 1);
+}
+
+static void test_flip_queue(const struct panel_case *pc,
+	struct fb_info *info)
+{
+	struct ftlcdc100_flip flip[FTLCDC100_FLIP_QUEUE_LEN];
+	struct ftlcdc100_flip_status status;
+	struct ftlcdc100_flip extra;
+	struct fb_var_screeninfo var;
+	unsigned int queued;
+	unsigned int i;
+	u32 sequence;
+
+	/* the probe time mode set is on screen */
+	mock_vblank();
+	CHECK(ftlcdc100_ioctl(info, FTLCDC100IOC_GET_FLIP_STATUS,
+		(unsigned long)&status) == 0);
+	CHECK(status.displayed == status.queued);
+	CHECK(status.pending == 0);
+	queued = status.queued;
+
+	/* every flip gets the next sequence number */
+	mock_clear_writes();
+	for (i = 0; i < FTLCDC100_FLIP_QUEUE_LEN; i++) {
+		flip[i].yoffset = (i + 1) % 2 * info->var.yres;
+		CHECK(ftlcdc100_ioctl(info, FTLCDC100IOC_QUEUE_FLIP,
+			(unsigned long)&flip[i]) == 0);
+		CHECK(flip[i].sequence == queued + i + 1);
+	}
+
+	/* until the queue drains there is no room for more */
+	extra.yoffset = 0;
+	CHECK(ftlcdc100_ioctl(info, FTLCDC100IOC_QUEUE_FLIP,
+		(unsigned long)&extra) == -EBUSY);
+
+	CHECK(ftlcdc100_ioctl(info, FTLCDC100IOC_GET_FLIP_STATUS,
+		(unsigned long)&status) == 0);
+	CHECK(status.queued == queued + FTLCDC100_FLIP_QUEUE_LEN);
+	CHECK(status.displayed == queued);
+	CHECK(status.pending == FTLCDC100_FLIP_QUEUE_LEN);
+	CHECK(count_writes(FTLCDC100_OFFSET_LCD_FRAME_BASE, NULL) == 0);
+
+	/* without a vblank the wait times out */
+	sequence = flip[FTLCDC100_FLIP_QUEUE_LEN - 1].sequence;
+	CHECK(ftlcdc100_ioctl(info, FTLCDC100IOC_WAIT_FLIP,
+		(unsigned long)&sequence) == -ETIMEDOUT);
+
+	/* one flip is written per vblank, and is on screen at the next */
+	mock_vblank();
+	CHECK_REG(FTLCDC100_OFFSET_LCD_FRAME_BASE, info->fix.smem_start
+		+ flip[0].yoffset * info->fix.line_length);
+	CHECK(ftlcdc100_ioctl(info, FTLCDC100IOC_GET_FLIP_STATUS,
+		(unsigned long)&status) == 0);
+	CHECK(status.displayed == queued);
+	CHECK(status.pending == FTLCDC100_FLIP_QUEUE_LEN);
+
+	mock_vblank();
+	CHECK(ftlcdc100_ioctl(info, FTLCDC100IOC_GET_FLIP_STATUS,
+		(unsigned long)&status) == 0);
+	CHECK(status.displayed == flip[0].sequence);
+	CHECK(status.yoffset == flip[0].yoffset);
+
+	for (i = 2; i < FTLCDC100_FLIP_QUEUE_LEN; i++)
+		mock_vblank();
+
+	mock_wait_hook = mock_vblank;
+	CHECK(ftlcdc100_ioctl(info, FTLCDC100IOC_WAIT_FLIP,
+		(unsigned long)&sequence) == 0);
+	mock_wait_hook = NULL;
+
+	CHECK(ftlcdc100_ioctl(info, FTLCDC100IOC_GET_FLIP_STATUS,
+		(unsigned long)&status) == 0);
+	CHECK(status.displayed == sequence);
+	CHECK(status.yoffset == flip[FTLCDC100_FLIP_QUEUE_LEN - 1].yoffset);
+	CHECK(status.pending == 0);
+
+	/* and a flip already on screen needs no wait */
+	CHECK(ftlcdc100_ioctl(info, FTLCDC100IOC_WAIT_FLIP,
+		(unsigned long)&flip[0].sequence) == 0);
+
+	/* a pan drops the queued flips and retires their sequence numbers */
+	CHECK(ftlcdc100_ioctl(info, FTLCDC100IOC_QUEUE_FLIP,
+		(unsigned long)&flip[0]) == 0);
+	sequence = flip[0].sequence;
+	var = info->var;
+	var.yoffset = 0;
+	CHECK(ftlcdc100_pan_display(&var, info) == 0);
+	mock_vblank();
+	CHECK(ftlcdc100_ioctl(info, FTLCDC100IOC_WAIT_FLIP,
+		(unsigned long)&sequence) == 0);
+	CHECK(ftlcdc100_flip_pending(info->par) == 0);
+}
+
+static void test_wait_for_vsync(const struct panel_case *pc,
+	struct fb_info *info)
+{
+	struct ftlcdc100 *ftlcdc100 = info->par;
+	unsigned int vsync_count = ftlcdc100->vsync_count;
+	u32 crtc;
+
+	/* there is only one output */
+	crtc = 1;
+	CHECK(ftlcdc100_ioctl(info, FBIO_WAITFORVSYNC,
+		(unsigned long)&crtc) == -ENODEV);
+
+	crtc = 0;
+	CHECK(ftlcdc100_ioctl(info, FBIO_WAITFORVSYNC,
+		(unsigned long)&crtc) == -ETIMEDOUT);
+	CHECK(ftlcdc100->vsync_count == vsync_count);
+
+	mock_wait_hook = mock_vblank;
+	CHECK(ftlcdc100_ioctl(info, FBIO_WAITFORVSYNC,
+		(unsigned long)&crtc) == 0);
+	mock_wait_hook = NULL;
+	CHECK(ftlcdc100->vsync_count == vsync_count + 1);
+}
+
+static void test_get_buffer(const struct panel_case *pc,
+	struct fb_info *info)
+{
+	unsigned long frame = info->fix.line_length * info->var.yres;
+	struct ftlcdc100_buffer buffer;
+	unsigned int i;
+
+	for (i = 0; i < (unsigned int)vpages; i++) {
+		memset(&buffer, 0xff, sizeof(buffer));
+		buffer.index = i;
+		CHECK(ftlcdc100_ioctl(info, FTLCDC100IOC_GET_BUFFER,
+			(unsigned long)&buffer) == 0);
+		CHECK(buffer.count == (unsigned int)vpages);
+		CHECK(buffer.yoffset == i * info->var.yres);
+		CHECK(buffer.offset == i * frame);
+		CHECK(buffer.phys == info->fix.smem_start + i * frame);
+		CHECK(buffer.size == frame);
+		CHECK(buffer.line_length == info->fix.line_length);
+	}
+
+	buffer.index = vpages;
+	CHECK(ftlcdc100_ioctl(info, FTLCDC100IOC_GET_BUFFER,
+		(unsigned long)&buffer) == -EINVAL);
+}
+
+static void test_phys_flip(const struct panel_case *pc,
+	struct fb_info *info)
+{
+	unsigned long frame = info->fix.line_length * info->var.yres;
+	struct ftlcdc100_phys_flip phys_flip;
+	struct ftlcdc100_flip_status status;
+	struct ftlcdc100_flip flip;
+	dma_addr_t phys;
+	void *buf;
+
+	/* a video decoder's output surface */
+	buf = dma_alloc_writecombine(NULL, frame, &phys, GFP_KERNEL);
+	CHECK(buf != NULL);
+	if (!buf)
+		return;
+
+	mock_vblank();
+
+	/* FRAME_BASE cannot hold an unaligned address */
+	phys_flip.phys = phys + FTLCDC100_FRAME_BASE_ALIGN / 2;
+	CHECK(ftlcdc100_ioctl(info, FTLCDC100IOC_QUEUE_PHYS_FLIP,
+		(unsigned long)&phys_flip) == -EINVAL);
+
+	phys_flip.phys = phys;
+	CHECK(ftlcdc100_ioctl(info, FTLCDC100IOC_QUEUE_PHYS_FLIP,
+		(unsigned long)&phys_flip) == 0);
+
+	mock_vblank();
+	CHECK_REG(FTLCDC100_OFFSET_LCD_FRAME_BASE, phys);
+	mock_vblank();
+	CHECK(ftlcdc100_ioctl(info, FTLCDC100IOC_GET_FLIP_STATUS,
+		(unsigned long)&status) == 0);
+	CHECK(status.displayed == phys_flip.sequence);
+	CHECK(status.yoffset == FTLCDC100_FLIP_EXTERNAL);
+
+	/* back to the frame buffer, after which the surface may be freed */
+	flip.yoffset = 0;
+	CHECK(ftlcdc100_ioctl(info, FTLCDC100IOC_QUEUE_FLIP,
+		(unsigned long)&flip) == 0);
+	CHECK(flip.sequence == phys_flip.sequence + 1);
+	mock_vblank();
+	CHECK_REG(FTLCDC100_OFFSET_LCD_FRAME_BASE, info->fix.smem_start);
+	mock_vblank();
+	CHECK(ftlcdc100_ioctl(info, FTLCDC100IOC_GET_FLIP_STATUS,
+		(unsigned long)&status) == 0);
+	CHECK(status.yoffset == 0);
+
+	dma_free_writecombine(NULL, frame, buf, phys);
+}
+
+static void test_yuv422(const struct panel_case *pc, struct fb_info *info)
+{
+	u32 control;
+
+	info->var.nonstd = FTLCDC100_NONSTD_YUV422;
+	info->var.bits_per_pixel = 8;
+	CHECK(ftlcdc100_check_var(&info->var, info) == 0);
+	CHECK(info->var.bits_per_pixel == 16);
+	CHECK(info->var.red.length == 0 && info->var.blue.length == 0);
+
+	mock_wait_hook = mock_vblank;
+	CHECK(ftlcdc100_set_par(info) == 0);
+	mock_wait_hook = NULL;
+
+	control = mock_reg(FTLCDC100_OFFSET_LCD_CONTROL);
+	CHECK(control & FTLCDC100_LCD_CONTROL_YUV);
+	CHECK(!(control & FTLCDC100_LCD_CONTROL_YUV420));
+	CHECK((control & (0x7 << 1)) == FTLCDC100_LCD_CONTROL_BPP16);
+	CHECK(info->fix.line_length == info->var.xres * 2);
+	CHECK(info->fix.ypanstep == 1);
+	CHECK_REG(FTLCDC100_OFFSET_LCD_FRAME_BASE, info->fix.smem_start);
+
+	/* and back to RGB */
+	info->var.nonstd = 0;
+	CHECK(ftlcdc100_check_var(&info->var, info) == 0);
+	mock_wait_hook = mock_vblank;
+	CHECK(ftlcdc100_set_par(info) == 0);
+	mock_wait_hook = NULL;
+	CHECK_REG(FTLCDC100_OFFSET_LCD_CONTROL, pc->control);
+}
+
+static void test_yuv420(const struct panel_case *pc, struct fb_info *info)
+{
+	struct ftlcdc100_buffer buffer;
+	struct fb_var_screeninfo var;
+	unsigned long frame;
+	u32 frame420;
+	u32 control;
+
+	info->var.nonstd = FTLCDC100_NONSTD_YUV420;
+	info->var.yres_virtual = info->var.yres + 1;
+	CHECK(ftlcdc100_check_var(&info->var, info) == 0);
+	CHECK(info->var.bits_per_pixel == 12);
+
+	/* frames are panned as a whole */
+	CHECK(info->var.yres_virtual == 2 * info->var.yres);
+
+	mock_wait_hook = mock_vblank;
+	CHECK(ftlcdc100_set_par(info) == 0);
+	mock_wait_hook = NULL;
+
+	control = mock_reg(FTLCDC100_OFFSET_LCD_CONTROL);
+	CHECK(control & FTLCDC100_LCD_CONTROL_YUV);
+	CHECK(control & FTLCDC100_LCD_CONTROL_YUV420);
+	CHECK((control & (0x7 << 1)) == FTLCDC100_LCD_CONTROL_BPP16);
+
+	/* line_length is that of the Y plane, U and V follow each frame */
+	CHECK(info->fix.line_length == info->var.xres);
+	CHECK(info->fix.ypanstep == info->var.yres);
+	frame = info->var.xres * info->var.yres * 3 / 2;
+
+	frame420 = info->var.xres == 320
+		 ? FTLCDC100_LCD_FRAME_BASE_FRAME420_320X240
+		 : FTLCDC100_LCD_FRAME_BASE_FRAME420_640X480;
+	CHECK_REG(FTLCDC100_OFFSET_LCD_FRAME_BASE,
+		info->fix.smem_start | frame420);
+
+	var = info->var;
+	var.yoffset = info->var.yres / 2;
+	CHECK(ftlcdc100_pan_display(&var, info) == -EINVAL);
+
+	var.yoffset = info->var.yres;
+	CHECK(ftlcdc100_pan_display(&var, info) == 0);
+	CHECK_REG(FTLCDC100_OFFSET_LCD_FRAME_BASE,
+		(info->fix.smem_start + frame) | frame420);
+
+	buffer.index = 1;
+	CHECK(ftlcdc100_ioctl(info, FTLCDC100IOC_GET_BUFFER,
+		(unsigned long)&buffer) == 0);
+	CHECK(buffer.count == 2);
+	CHECK(buffer.offset == frame);
+	CHECK(buffer.size == frame);
+	CHECK(buffer.line_length == info->var.xres);
+}
+
+static void test_read_write(const struct panel_case *pc,
+	struct fb_info *info)
+{
+	struct ftlcdc100 *ftlcdc100 = info->par;
+	unsigned long total = info->fix.smem_len;
+	char buf[32];
+	loff_t pos;
+
+	memset(buf, 0x5a, sizeof(buf));
+
+	/* a write across the end of the buffer is cut short */
+	pos = total - 10;
+	CHECK(ftlcdc100_write(info, buf, sizeof(buf), &pos) == 10);
+	CHECK(pos == total);
+	CHECK(((u8 *)ftlcdc100->vram)[total - 1] == 0x5a);
+
+	/* then there is no space left, and past the end is too big */
+	CHECK(ftlcdc100_write(info, buf, sizeof(buf), &pos) == -ENOSPC);
+	pos = total + 1;
+	CHECK(ftlcdc100_write(info, buf, sizeof(buf), &pos) == -EFBIG);
+
+	/* reads stop at the end of the buffer */
+	memset(buf, 0, sizeof(buf));
+	pos = total - 4;
+	CHECK(ftlcdc100_read(info, buf, sizeof(buf), &pos) == 4);
+	CHECK(pos == total);
+	CHECK(buf[0] == 0x5a && buf[3] == 0x5a && buf[4] == 0);
+	CHECK(ftlcdc100_read(info, buf, sizeof(buf), &pos) == 0);
+
+	/* nothing while suspended */
+	info->state = FBINFO_STATE_SUSPENDED;
+	pos = 0;
+	CHECK(ftlcdc100_read(info, buf, sizeof(buf), &pos) == -EPERM);
+	CHECK(ftlcdc100_write(info, buf, sizeof(buf), &pos) == -EPERM);
+	info->state = FBINFO_STATE_RUNNING;
+}
+
+static void test_write_flip(const struct panel_case *pc,
+	struct fb_info *info)
+{
+	struct ftlcdc100 *ftlcdc100 = info->par;
+	unsigned long frame = info->fix.line_length * info->var.yres;
+	unsigned long half = frame / 2;
+	char *buf;
+	loff_t pos = 0;
+
+	buf = malloc(frame);
+	CHECK(buf != NULL);
+	if (!buf)
+		return;
+
+	ftlcdc100->write_flip = 1;
+
+	/* the probe time mode set is on screen, its buffer can be reused */
+	mock_vblank();
+
+	/* a frame in two writes goes to the back buffer */
+	memset(buf, 0x11, frame);
+	CHECK(ftlcdc100_write(info, buf, half, &pos) == (ssize_t)half);
+	CHECK(pos == half);
+	CHECK(ftlcdc100->write_yoffset == info->var.yres);
+	CHECK(ftlcdc100_write(info, buf + half, frame - half, &pos)
+		== (ssize_t)(frame - half));
+	CHECK(pos == 0);
+	CHECK(((u8 *)ftlcdc100->vram)[frame] == 0x11);
+	CHECK(((u8 *)ftlcdc100->vram)[2 * frame - 1] == 0x11);
+
+	mock_vblank();
+	CHECK_REG(FTLCDC100_OFFSET_LCD_FRAME_BASE,
+		info->fix.smem_start + frame);
+
+	/* the offset wrapped, the next frame goes to the other buffer */
+	mock_wait_hook = mock_vblank;
+	memset(buf, 0x22, frame);
+	CHECK(ftlcdc100_write(info, buf, frame, &pos) == (ssize_t)frame);
+	mock_wait_hook = NULL;
+	CHECK(pos == 0);
+	CHECK(ftlcdc100->write_yoffset == 0);
+	CHECK(((u8 *)ftlcdc100->vram)[0] == 0x22);
+	CHECK(((u8 *)ftlcdc100->vram)[frame] == 0x11);
+
+	mock_vblank();
+	CHECK_REG(FTLCDC100_OFFSET_LCD_FRAME_BASE, info->fix.smem_start);
+
+	/* a flip that cannot be queued fails the write, which can be retried */
+	mock_wait_hook = mock_vblank;
+	CHECK(ftlcdc100_write(info, buf, half, &pos) == (ssize_t)half);
+	mock_wait_hook = NULL;
+
+	ftlcdc100->commit_async = 1;
+	CHECK(ftlcdc100_set_par(info) == 0);
+	CHECK(ftlcdc100->commit_done != ftlcdc100->commit_queued);
+
+	CHECK(ftlcdc100_write(info, buf + half, frame - half, &pos) == -EBUSY);
+	CHECK(pos == half);
+
+	mock_vblank();
+	CHECK(ftlcdc100_write(info, buf + half, frame - half, &pos)
+		== (ssize_t)(frame - half));
+	CHECK(pos == 0);
+
+	free(buf);
+}
+
+static void test_interrupt(const struct panel_case *pc, struct fb_info *info)
+{
+	struct ftlcdc100 *ftlcdc100 = info->par;
+	unsigned int vsync_count = ftlcdc100->vsync_count;
+	u32 status = FTLCDC100_LCD_INT_UNDERRUN | FTLCDC100_LCD_INT_NEXT_BASE;
+	int i;
+
+	mock_clear_writes();
+	CHECK(mock_irq(status) == IRQ_HANDLED);
+	CHECK(ftlcdc100->vsync_count == vsync_count + 1);
+	CHECK(ftlcdc100->stats.underrun == 1);
+	CHECK(ftlcdc100->stats.next_base == 1);
+
+	/* exactly the raised bits are acknowledged */
+	i = mock_last_write(FTLCDC100_OFFSET_LCD_INT_CLEAR);
+	CHECK(i >= 0);
+	if (i >= 0)
+		CHECK(mock_get_write(i)->val == status);
+
+	/* a window full of underruns raises the FIFO threshold */
+	for (i = 0; i < FTLCDC100_UNDERRUN_WINDOW; i++)
+		mock_irq(status);
+	CHECK(ftlcdc100->fifo_threshold);
+	CHECK_REG(FTLCDC100_OFFSET_LCD_CONTROL,
+		pc->control | FTLCDC100_LCD_CONTROL_FIFO_THRESHOLD);
+
+	/* and it sticks across a mode set */
+	CHECK(ftlcdc100_set_par(info) == 0);
+	CHECK_REG(FTLCDC100_OFFSET_LCD_CONTROL,
+		pc->control | FTLCDC100_LCD_CONTROL_FIFO_THRESHOLD);
+}
+
+static void test_interrupt_staged(const struct panel_case *pc,
+	struct fb_info *info)
+{
+	struct ftlcdc100 *ftlcdc100 = info->par;
+
+	/* a threshold switch while a mode set waits for vblank is kept */
+	ftlcdc100->commit_async = 1;
+	info->var.bits_per_pixel = 8;
+	CHECK(ftlcdc100_check_var(&info->var, info) == 0);
+	CHECK(ftlcdc100_set_par(info) == 0);
+	ftlcdc100->fifo_threshold = 1;
+	mock_vblank();
+
+	CHECK(ftlcdc100->commit_done == ftlcdc100->commit_queued);
+	CHECK_REG(FTLCDC100_OFFSET_LCD_CONTROL,
+		(pc->control & ~(0x7 << 1)) | FTLCDC100_LCD_CONTROL_BPP8
+		| FTLCDC100_LCD_CONTROL_FIFO_THRESHOLD);
+}
+
+static void test_interrupt_unregistered(const struct panel_case *pc,
+	struct fb_info *info)
+{
+	struct ftlcdc100 *ftlcdc100 = info->par;
+	struct fb_var_screeninfo var = info->var;
+	u32 status = FTLCDC100_LCD_INT_UNDERRUN | FTLCDC100_LCD_INT_NEXT_BASE
+		   | FTLCDC100_LCD_INT_BUS_ERROR;
+	struct device *dev = info->dev;
+	int i;
+
+	/* as during probe, before register_framebuffer() */
+	info->dev = NULL;
+
+	var.yoffset = info->var.yres;
+	CHECK(ftlcdc100_pan_display(&var, info) == 0);
+
+	/* retire a flip, report errors and give up on underruns */
+	for (i = 0; i < 2 * FTLCDC100_UNDERRUN_WINDOW; i++)
+		mock_irq(status);
+	CHECK(ftlcdc100->flip_displayed == ftlcdc100->flip_queued);
+	CHECK(ftlcdc100->underrun_advice);
+
+	info->dev = dev;
+}
+
+static void test_suspend_resume(const struct panel_case *pc,
+	struct fb_info *info)
+{
+	static const unsigned int offsets[] = {
+		FTLCDC100_OFFSET_LCD_HTIMING,
+		FTLCDC100_OFFSET_LCD_VTIMING,
+		FTLCDC100_OFFSET_LCD_CLOCK_POLARITY,
+		FTLCDC100_OFFSET_LCD_FRAME_BASE,
+		FTLCDC100_OFFSET_LCD_INT_ENABLE,
+		FTLCDC100_OFFSET_LCD_CONTROL,
+	};
+	pm_message_t state = { 0 };
+	u32 saved[ARRAY_SIZE(offsets)];
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(offsets); i++)
+		saved[i] = mock_reg(offsets[i]);
+
+	CHECK(ftlcdc100_suspend(&mock_pdev, state) == 0);
+	CHECK_REG(FTLCDC100_OFFSET_LCD_CONTROL, 0);
+	CHECK_REG(FTLCDC100_OFFSET_LCD_INT_ENABLE, 0);
+	CHECK(mock_clk_enabled() == 0);
+	CHECK(info->state == FBINFO_STATE_SUSPENDED);
+
+	/* lost while powered down */
+	for (i = 0; i < ARRAY_SIZE(offsets); i++)
+		mock_set_reg(offsets[i], 0);
+
+	mock_clear_writes();
+	CHECK(ftlcdc100_resume(&mock_pdev) == 0);
+	CHECK(mock_clk_enabled() == 1);
+	CHECK(info->state == FBINFO_STATE_RUNNING);
+
+	for (i = 0; i < ARRAY_SIZE(offsets); i++)
+		CHECK_REG(offsets[i], saved[i]);
+
+	/* the LCD is enabled only once everything else is in place */
+	CHECK(mock_last_write(FTLCDC100_OFFSET_LCD_CONTROL)
+		== (int)mock_nr_writes() - 1);
+}
+
+static void test_osd(const struct panel_case *pc, struct fb_info *info)
+{
+	struct ftlcdc100_osd_attribute attr;
+	struct ftlcdc100_osd_glyph glyph;
+	struct ftlcdc100_osd_color color;
+	struct ftlcdc100_cursor cursor;
+	struct fb_var_screeninfo var;
+	struct fb_cursor fbcur;
+
+	memset(&glyph, 0, sizeof(glyph));
+	glyph.index = FTLCDC100_OSD_GLYPHS - 1;
+	glyph.bitmap[0] = 0xfff;
+	CHECK(ftlcdc100_ioctl(info, FTLCDC100IOC_OSD_SET_GLYPH,
+		(unsigned long)&glyph) == 0);
+	CHECK_REG(FTLCDC100_OFFSET_OSD_FONT
+		+ glyph.index * FTLCDC100_OSD_GLYPH_HEIGHT * 4, 0xfff);
+
+	/* fbcon's cursor follows the panned window */
+	var = info->var;
+	var.yoffset = 32;
+	CHECK(ftlcdc100_pan_display(&var, info) == 0);
+	info->var.yoffset = var.yoffset;	/* done by fb_pan_display() */
+	memset(&fbcur, 0, sizeof(fbcur));
+	fbcur.enable = 1;
+	fbcur.image.width = 8;
+	fbcur.image.height = 16;
+	fbcur.image.dx = 8;
+	fbcur.image.dy = var.yoffset + 16;
+	CHECK(ftlcdc100_cursor(info, &fbcur) == 0);
+	CHECK_REG(FTLCDC100_OFFSET_OSD_POSITION_CONTROL,
+		FTLCDC100_OSD_POSITION_CONTROL_HPOS(8)
+		| FTLCDC100_OSD_POSITION_CONTROL_VPOS(16));
+	CHECK_REG(FTLCDC100_OFFSET_OSD_SCALING_CONTROL,
+		FTLCDC100_OSD_SCALING_CONTROL_ENABLE);
+
+	/* off screen, it is hidden rather than left where it was */
+	fbcur.image.dy = var.yoffset + info->var.yres;
+	CHECK(ftlcdc100_cursor(info, &fbcur) == -EINVAL);
+	CHECK_REG(FTLCDC100_OFFSET_OSD_SCALING_CONTROL, 0);
+
+	attr.start = FTLCDC100_OSD_CELLS - 1;
+	attr.count = 1;
+	attr.attribute[0] = FTLCDC100_OSD_ATTRIBUTE_FONT(glyph.index);
+	CHECK(ftlcdc100_ioctl(info, FTLCDC100IOC_OSD_SET_ATTRIBUTE,
+		(unsigned long)&attr) == 0);
+	CHECK_REG(FTLCDC100_OFFSET_OSD_ATTRIBUTE + attr.start * 4,
+		attr.attribute[0]);
+
+	/* a 4K resource does not reach the OSD RAM */
+	remove_panel();
+	mock_reset(pc->clk_khz);
+	mock_set_mem_size(0x1000);
+	mode_option = (char *)pc->mode;
+	CHECK(ftlcdc100_probe(&mock_pdev) == 0);
+	info = platform_get_drvdata(&mock_pdev);
+
+	CHECK(ftlcdc100_ioctl(info, FTLCDC100IOC_OSD_SET_GLYPH,
+		(unsigned long)&glyph) == -ENODEV);
+	CHECK(ftlcdc100_ioctl(info, FTLCDC100IOC_OSD_SET_ATTRIBUTE,
+		(unsigned long)&attr) == -ENODEV);
+	memset(&color, 0, sizeof(color));
+	CHECK(ftlcdc100_ioctl(info, FTLCDC100IOC_OSD_SET_COLOR,
+		(unsigned long)&color) == -ENODEV);
+
+	/* and neither is there a hardware cursor */
+	cursor.enable = 1;
+	cursor.x = 0;
+	cursor.y = 0;
+	CHECK(ftlcdc100_ioctl(info, FTLCDC100IOC_SET_CURSOR,
+		(unsigned long)&cursor) == -ENODEV);
+}
+
+static u16 vram_pixel(struct fb_info *info, unsigned int x, unsigned int y)
+{
+	struct ftlcdc100 *ftlcdc100 = info->par;
+
+	return ((u16 *)ftlcdc100->vram)[y * info->var.xres + x];
+}
+
+static void test_convert(const struct panel_case *pc, struct fb_info *info)
+{
+	struct ftlcdc100 *ftlcdc100;
+	struct fb_var_screeninfo var16;
+	struct ftlcdc100_flip flip;
+	struct fb_var_screeninfo var;
+	unsigned int xres = info->var.xres;
+	unsigned int ones;
+	unsigned int x, y;
+	u32 *shadow;
+
+	var16 = info->var;
+	remove_panel();
+
+	convert = 1;
+	info = probe_panel(pc);
+	convert = 0;
+	CHECK(info != NULL);
+	if (!info)
+		return;
+
+	ftlcdc100 = info->par;
+	shadow = ftlcdc100->shadow;
+
+	/* clients see 32bpp, the controller is fed 16bpp */
+	info->var.bits_per_pixel = 32;
+	CHECK(ftlcdc100_check_var(&info->var, info) == 0);
+	CHECK(info->var.pixclock == var16.pixclock);
+	mock_wait_hook = mock_vblank;
+	CHECK(ftlcdc100_set_par(info) == 0);
+	mock_wait_hook = NULL;
+
+	CHECK_REG(FTLCDC100_OFFSET_LCD_HTIMING, pc->htiming);
+	CHECK_REG(FTLCDC100_OFFSET_LCD_VTIMING, pc->vtiming);
+	CHECK_REG(FTLCDC100_OFFSET_LCD_CONTROL, pc->control);
+	CHECK(info->fix.line_length == xres * 4);
+	CHECK(ftlcdc100_vram_line_length(info) == xres * 2);
+
+	/* primaries, and saturation without a carry into the next channel */
+	for (x = 0; x < 4; x++) {
+		shadow[x] = 0xffffffff;
+		shadow[4 + x] = 0x00ff0000;
+		shadow[8 + x] = 0x0000ff00;
+		shadow[12 + x] = 0x000000ff;
+		shadow[16 + x] = 0x00808080;
+	}
+	ftlcdc100_damage(info, 0, 1);
+
+	for (x = 0; x < 4; x++) {
+		CHECK(vram_pixel(info, x, 0) == 0xffff);
+		CHECK(vram_pixel(info, 4 + x, 0) == 0xf800);
+		CHECK(vram_pixel(info, 8 + x, 0) == 0x07e0);
+		CHECK(vram_pixel(info, 12 + x, 0) == 0x001f);
+		CHECK(vram_pixel(info, 16 + x, 0) == 0x8410);
+	}
+
+	/* half a step of blue comes out as every other pixel of a 4x4 block */
+	for (y = 0; y < 4; y++)
+		for (x = 0; x < 4; x++)
+			shadow[y * xres + x] = 0x00000004;
+	ftlcdc100_damage(info, 0, 4);
+
+	ones = 0;
+	for (y = 0; y < 4; y++)
+		for (x = 0; x < 4; x++)
+			ones += vram_pixel(info, x, y);
+	CHECK(ones == 8);
+
+	/* a flip brings damage not yet flushed onto the screen with it */
+	shadow[info->var.yres * xres] = 0x00ff0000;
+	ftlcdc100->dirty_y1 = ftlcdc100->dirty_y2 = info->var.yres;
+	flip.yoffset = info->var.yres;
+	CHECK(ftlcdc100_ioctl(info, FTLCDC100IOC_QUEUE_FLIP,
+		(unsigned long)&flip) == 0);
+	CHECK(vram_pixel(info, 0, info->var.yres) == 0xf800);
+
+	/* panning steps through vram in 16bpp lines */
+	var = info->var;
+	var.yoffset = 1;
+	CHECK(ftlcdc100_pan_display(&var, info) == 0);
+	CHECK_REG(FTLCDC100_OFFSET_LCD_FRAME_BASE,
+		info->fix.smem_start + xres * 2);
+}
+
+static void test_convert_write_flip(const struct panel_case *pc,
+	struct fb_info *info)
+{
+	struct ftlcdc100 *ftlcdc100;
+	unsigned int xres = info->var.xres;
+	unsigned int yres = info->var.yres;
+	unsigned long size = xres * yres * 4;
+	unsigned int x, y;
+	loff_t pos = 0;
+	u32 *frame;
+	int good;
+
+	remove_panel();
+
+	convert = 1;
+	info = probe_panel(pc);
+	convert = 0;
+	CHECK(info != NULL);
+	if (!info)
+		return;
+
+	ftlcdc100 = info->par;
+	info->var.bits_per_pixel = 32;
+	CHECK(ftlcdc100_check_var(&info->var, info) == 0);
+	mock_wait_hook = mock_vblank;
+	CHECK(ftlcdc100_set_par(info) == 0);
+	mock_wait_hook = NULL;
+
+	frame = malloc(size);
+	CHECK(frame != NULL);
+	if (!frame)
+		return;
+
+	for (x = 0; x < xres * yres; x++)
+		frame[x] = 0x00ff0000;
+
+	/* the mode set is on screen, its buffer can be reused */
+	mock_vblank();
+
+	/* the deferred I/O worker does not get to run before the vblank */
+	mock_hold_delayed_work(1);
+	ftlcdc100->write_flip = 1;
+	CHECK(ftlcdc100_write(info, (const char *)frame, size, &pos)
+		== (ssize_t)size);
+	CHECK(pos == 0);
+
+	mock_vblank();
+	CHECK_REG(FTLCDC100_OFFSET_LCD_FRAME_BASE,
+		info->fix.smem_start + yres * xres * 2);
+
+	good = 1;
+	for (y = yres; y < 2 * yres; y++)
+		for (x = 0; x < xres; x++)
+			if (vram_pixel(info, x, y) != 0xf800)
+				good = 0;
+	CHECK(good);
+
+	free(frame);
+}
+
+static void test_defio_pan(const struct panel_case *pc,
+	struct fb_info *info)
+{
+	struct ftlcdc100 *ftlcdc100;
+	struct fb_var_screeninfo var;
+	unsigned int line_length;
+	u16 *shadow;
+
+	remove_panel();
+
+	defio = 1;
+	info = probe_panel(pc);
+	defio = 0;
+	CHECK(info != NULL);
+	if (!info)
+		return;
+
+	ftlcdc100 = info->par;
+	line_length = info->fix.line_length;
+	shadow = ftlcdc100->shadow;
+
+	/* drawn into the back buffer, the worker has not run yet */
+	mock_hold_delayed_work(1);
+	shadow[info->var.yres * line_length / 2] = 0x1234;
+	ftlcdc100_damage(info, info->var.yres, 1);
+
+	var = info->var;
+	var.yoffset = info->var.yres;
+	CHECK(ftlcdc100_pan_display(&var, info) == 0);
+	CHECK(vram_pixel(info, 0, info->var.yres) == 0x1234);
+}
+
+static void test_fastboot(const struct panel_case *pc, struct fb_info *info)
+{
+	unsigned long frame = info->fix.line_length * info->var.yres;
+	struct ftlcdc100 *ftlcdc100;
+	dma_addr_t splash_phys;
+	unsigned int i;
+	int good;
+	u16 *splash;
+	u16 *vram;
+
+	remove_panel();
+
+	/* what the boot loader left: its picture on a running LCD */
+	mock_reset(pc->clk_khz);
+	splash = dma_alloc_writecombine(NULL, frame, &splash_phys, GFP_KERNEL);
+	CHECK(splash != NULL);
+	if (!splash)
+		return;
+
+	for (i = 0; i < frame / 2; i++)
+		splash[i] = i;
+
+	mock_set_reg(FTLCDC100_OFFSET_LCD_HTIMING, pc->htiming);
+	mock_set_reg(FTLCDC100_OFFSET_LCD_VTIMING, pc->vtiming);
+	mock_set_reg(FTLCDC100_OFFSET_LCD_CLOCK_POLARITY, pc->clock_polarity);
+	mock_set_reg(FTLCDC100_OFFSET_LCD_CONTROL, pc->control);
+	mock_set_reg(FTLCDC100_OFFSET_LCD_FRAME_BASE, splash_phys);
+	mock_set_reg(FTLCDC100_OFFSET_PALETTE, 0x7c00001f);
+
+	/* the mode comes from the registers, not from the mode option */
+	fastboot = 1;
+	mode_option = "320x240-8";
+	CHECK(ftlcdc100_probe(&mock_pdev) == 0);
+	fastboot = 0;
+	mode_option = NULL;
+
+	info = platform_get_drvdata(&mock_pdev);
+	ftlcdc100 = info->par;
+	CHECK(ftlcdc100->fastboot);
+	CHECK(info->var.bits_per_pixel == 16);
+	CHECK(info->var.yres_virtual == info->var.yres * vpages);
+
+	/* the same timings, the LCD is never switched off */
+	CHECK_REG(FTLCDC100_OFFSET_LCD_HTIMING, pc->htiming);
+	CHECK_REG(FTLCDC100_OFFSET_LCD_VTIMING, pc->vtiming);
+	CHECK_REG(FTLCDC100_OFFSET_LCD_CLOCK_POLARITY, pc->clock_polarity);
+	CHECK_REG(FTLCDC100_OFFSET_LCD_CONTROL, pc->control);
+	for (i = 0; i < mock_nr_writes(); i++)
+		if (mock_get_write(i)->offset == FTLCDC100_OFFSET_LCD_CONTROL)
+			CHECK(mock_get_write(i)->val
+				& FTLCDC100_LCD_CONTROL_ENABLE);
+
+	/* the picture moved to our buffer before the base was switched */
+	CHECK_REG(FTLCDC100_OFFSET_LCD_FRAME_BASE, info->fix.smem_start);
+	CHECK(count_writes(FTLCDC100_OFFSET_LCD_FRAME_BASE, NULL) == 1);
+	CHECK(ftlcdc100->palette[0] == 0x001f);
+	CHECK(ftlcdc100->palette[1] == 0x7c00);
+
+	vram = ftlcdc100->vram;
+	good = 1;
+	for (i = 0; i < frame / 2; i++)
+		if (vram[i] != splash[i])
+			good = 0;
+	CHECK(good);
+
+	/* and the rest of the buffer was cleared after registration */
+	good = 1;
+	for (i = frame / 2; i < info->fix.smem_len / 2; i++)
+		if (vram[i])
+			good = 0;
+	CHECK(good);
+	CHECK(ftlcdc100->zero_start == info->fix.smem_len);
+
+	dma_free_writecombine(NULL, frame, splash, splash_phys);
+}
+
+/*
+ * The drawing tests compare the whole visible screen with a model, so
+ * stray stores outside the drawn area are caught as well.
+ */
+static u32 screen_pixel(struct fb_info *info, unsigned int x, unsigned int y)
+{
+	u8 *line = (u8 *)info->screen_base + y * info->fix.line_length;
+
+	if (info->var.bits_per_pixel == 16)
+		return ((u16 *)line)[x];
+
+	return ((u32 *)line)[x];
+}
+
+static void set_screen_pixel(struct fb_info *info, unsigned int x,
+	unsigned int y, u32 val)
+{
+	u8 *line = (u8 *)info->screen_base + y * info->fix.line_length;
+
+	if (info->var.bits_per_pixel == 16)
+		((u16 *)line)[x] = val;
+	else
+		((u32 *)line)[x] = val;
+}
+
+/*
+ * Fills the screen with a pattern of distinct pixels and returns a model
+ * of it, which the caller must free.
+ */
+static u32 *fill_pattern(struct fb_info *info)
+{
+	unsigned int xres = info->var.xres;
+	unsigned int yres = info->var.yres;
+	u32 mask = info->var.bits_per_pixel == 16 ? 0xffff : 0xffffffff;
+	unsigned int x, y;
+	u32 *model;
+
+	model = malloc(xres * yres * sizeof(*model));
+	if (!model)
+		return NULL;
+
+	for (y = 0; y < yres; y++)
+		for (x = 0; x < xres; x++) {
+			model[y * xres + x] = (y * 1031 + x * 7 + 1) & mask;
+			set_screen_pixel(info, x, y, model[y * xres + x]);
+		}
+
+	return model;
+}
+
+static int screen_matches(struct fb_info *info, const u32 *model)
+{
+	unsigned int x, y;
+
+	for (y = 0; y < info->var.yres; y++)
+		for (x = 0; x < info->var.xres; x++)
+			if (screen_pixel(info, x, y)
+			 != model[y * info->var.xres + x])
+				return 0;
+
+	return 1;
+}
+
+/*
+ * Switches to a truecolor depth.  One screen of 32bpp fits the memory
+ * reserved for two of 16bpp.
+ */
+static int set_depth(struct fb_info *info, unsigned int bpp)
+{
+	int ret;
+
+	info->var.bits_per_pixel = bpp;
+	info->var.yres_virtual = info->var.yres;
+	info->var.yoffset = 0;
+	ret = ftlcdc100_check_var(&info->var, info);
+	if (ret)
+		return ret;
+
+	mock_wait_hook = mock_vblank;
+	ret = ftlcdc100_set_par(info);
+	mock_wait_hook = NULL;
+	return ret;
+}
+
+static void test_fillrect(const struct panel_case *pc, struct fb_info *info)
+{
+	static const struct {
+		unsigned int dx, dy, width, height;
+	} rects[] = {
+		{ 1, 1, 1, 1 },		/* single half word */
+		{ 1, 2, 6, 3 },		/* odd start, even width */
+		{ 3, 0, 5, 2 },		/* odd start, odd width */
+		{ 2, 4, 9, 1 },		/* even start, odd end */
+		{ 5, 3, 21, 4 },	/* bursts between odd edges */
+		{ 0, 6, 32, 2 },	/* whole words only */
+	};
+	static const unsigned int depths[] = { 16, 32 };
+	struct fb_fillrect rect;
+	unsigned int i, j;
+	unsigned int x, y;
+	u32 *model;
+	u32 color;
+
+	for (i = 0; i < ARRAY_SIZE(depths); i++) {
+		CHECK(set_depth(info, depths[i]) == 0);
+		color = depths[i] == 16 ? 0xf81f : 0x00ff00ff;
+		((u32 *)info->pseudo_palette)[3] = color;
+
+		for (j = 0; j < ARRAY_SIZE(rects); j++) {
+			model = fill_pattern(info);
+			CHECK(model != NULL);
+			if (!model)
+				return;
+
+			rect.dx = rects[j].dx;
+			rect.dy = rects[j].dy;
+			rect.width = rects[j].width;
+			rect.height = rects[j].height;
+			rect.color = 3;
+			rect.rop = ROP_COPY;
+			ftlcdc100_fillrect(info, &rect);
+
+			for (y = rect.dy; y < rect.dy + rect.height; y++)
+				for (x = rect.dx; x < rect.dx + rect.width; x++)
+					model[y * info->var.xres + x] = color;
+			CHECK(screen_matches(info, model));
+			free(model);
+		}
+	}
+}
+
+static void test_copyarea(const struct panel_case *pc, struct fb_info *info)
+{
+	static const struct {
+		unsigned int sx, sy, dx, dy, width, height;
+	} areas[] = {
+		{ 2, 1, 2, 3, 5, 6 },	/* down, overlapping */
+		{ 2, 3, 2, 1, 5, 6 },	/* up, overlapping */
+		{ 1, 2, 4, 2, 7, 3 },	/* right, within the lines */
+		{ 4, 2, 1, 2, 7, 3 },	/* left, within the lines */
+		{ 1, 1, 2, 2, 6, 6 },	/* down and right */
+		{ 3, 4, 0, 1, 9, 5 },	/* up and left */
+		{ 5, 0, 2, 10, 3, 2 },	/* apart */
+	};
+	static const unsigned int depths[] = { 16, 32 };
+	struct fb_copyarea area;
+	unsigned int xres;
+	unsigned int i, j;
+	unsigned int x, y;
+	u32 *model;
+	u32 *copy;
+
+	for (i = 0; i < ARRAY_SIZE(depths); i++) {
+		CHECK(set_depth(info, depths[i]) == 0);
+		xres = info->var.xres;
+
+		for (j = 0; j <= ARRAY_SIZE(areas); j++) {
+			/* the last one scrolls full lines, as fbcon does */
+			if (j < ARRAY_SIZE(areas)) {
+				area.sx = areas[j].sx;
+				area.sy = areas[j].sy;
+				area.dx = areas[j].dx;
+				area.dy = areas[j].dy;
+				area.width = areas[j].width;
+				area.height = areas[j].height;
+			} else {
+				area.sx = area.dx = 0;
+				area.sy = 16;
+				area.dy = 0;
+				area.width = xres;
+				area.height = info->var.yres - 16;
+			}
+
+			model = fill_pattern(info);
+			copy = malloc(area.width * area.height * sizeof(*copy));
+			CHECK(model != NULL && copy != NULL);
+			if (!model || !copy) {
+				free(model);
+				free(copy);
+				return;
+			}
+
+			ftlcdc100_copyarea(info, &area);
+
+			for (y = 0; y < area.height; y++)
+				for (x = 0; x < area.width; x++)
+					copy[y * area.width + x] = model[
+						(area.sy + y) * xres
+						+ area.sx + x];
+			for (y = 0; y < area.height; y++)
+				for (x = 0; x < area.width; x++)
+					model[(area.dy + y) * xres
+						+ area.dx + x] =
+						copy[y * area.width + x];
+
+			CHECK(screen_matches(info, model));
+			free(model);
+			free(copy);
+		}
+	}
+}
+
+/*
+ * Draws a 1bpp image and applies it to @model, with the colours the driver
+ * should look up in the pseudo palette.
+ */
+static void blit(struct fb_info *info, u32 *model, unsigned int dx,
+	unsigned int dy, unsigned int width, unsigned int height)
+{
+	static u8 data[4 * 16];
+	unsigned int pitch = DIV_ROUND_UP(width, 8);
+	u32 fg = ((u32 *)info->pseudo_palette)[15];
+	u32 bg = ((u32 *)info->pseudo_palette)[1];
+	struct fb_image image;
+	unsigned int x, y;
+	u8 bits;
+
+	for (x = 0; x < sizeof(data); x++)
+		data[x] = x * 37 + 0x5b;
+
+	memset(&image, 0, sizeof(image));
+	image.dx = dx;
+	image.dy = dy;
+	image.width = width;
+	image.height = height;
+	image.fg_color = 15;
+	image.bg_color = 1;
+	image.depth = 1;
+	image.data = (const char *)data;
+	ftlcdc100_imageblit(info, &image);
+
+	for (y = 0; y < height; y++)
+		for (x = 0; x < width; x++) {
+			bits = data[y * pitch + x / 8];
+			model[(dy + y) * info->var.xres + dx + x] =
+				bits & (0x80 >> (x % 8)) ? fg : bg;
+		}
+}
+
+static void test_imageblit(const struct panel_case *pc, struct fb_info *info)
+{
+	static const struct {
+		unsigned int dx, dy, width, height;
+	} images[] = {
+		{ 0, 0, 8, 16 },	/* a console glyph */
+		{ 1, 2, 8, 16 },	/* at an odd pixel */
+		{ 3, 1, 12, 16 },	/* a 12 pixel wide font */
+		{ 2, 5, 5, 7 },		/* narrower than a span */
+		{ 7, 3, 27, 2 },	/* spans and a tail, odd start */
+	};
+	static const unsigned int depths[] = { 16, 32 };
+	u32 *pseudo_palette = info->pseudo_palette;
+	unsigned int i, j;
+	u32 *model;
+
+	for (i = 0; i < ARRAY_SIZE(depths); i++) {
+		CHECK(set_depth(info, depths[i]) == 0);
+
+		for (j = 0; j < ARRAY_SIZE(images); j++) {
+			model = fill_pattern(info);
+			CHECK(model != NULL);
+			if (!model)
+				return;
+
+			blit(info, model, images[j].dx, images[j].dy,
+				images[j].width, images[j].height);
+			CHECK(screen_matches(info, model));
+			free(model);
+		}
+	}
+
+	/*
+	 * The glyph cache is keyed by pixel values.  The same values give
+	 * spans of a different layout after a depth change.
+	 */
+	CHECK(set_depth(info, 16) == 0);
+	pseudo_palette[15] = 0xffff;
+	pseudo_palette[1] = 0x0000;
+	model = fill_pattern(info);
+	CHECK(model != NULL);
+	if (!model)
+		return;
+	blit(info, model, 0, 0, 8, 16);
+	CHECK(screen_matches(info, model));
+	free(model);
+
+	CHECK(set_depth(info, 32) == 0);
+	model = fill_pattern(info);
+	CHECK(model != NULL);
+	if (!model)
+		return;
+	blit(info, model, 0, 0, 8, 16);
+	CHECK(screen_matches(info, model));
+	free(model);
+}
+
+static void test_imageblit_cmap(const struct panel_case *pc,
+	struct fb_info *info)
+{
+	u16 red[16], green[16], blue[16];
+	u32 *pseudo_palette = info->pseudo_palette;
+	struct fb_cmap cmap;
+	u32 before;
+	u32 *model;
+
+	memset(red, 0, sizeof(red));
+	memset(green, 0, sizeof(green));
+	memset(blue, 0, sizeof(blue));
+	cmap.start = 0;
+	cmap.len = 16;
+	cmap.red = red;
+	cmap.green = green;
+	cmap.blue = blue;
+	cmap.transp = NULL;
+
+	red[15] = 0xffff;
+	CHECK(ftlcdc100_setcmap(&cmap, info) == 0);
+	before = pseudo_palette[15];
+
+	model = fill_pattern(info);
+	CHECK(model != NULL);
+	if (!model)
+		return;
+	blit(info, model, 8, 16, 8, 16);
+	CHECK(screen_matches(info, model));
+	free(model);
+
+	/* a new colour map takes effect with the next glyph drawn */
+	red[15] = 0;
+	blue[15] = 0xffff;
+	CHECK(ftlcdc100_setcmap(&cmap, info) == 0);
+	CHECK(pseudo_palette[15] != before);
+
+	model = fill_pattern(info);
+	CHECK(model != NULL);
+	if (!model)
+		return;
+	blit(info, model, 8, 16, 8, 16);
+	CHECK(screen_matches(info, model));
+	free(model);
+
+	/* and so does a pseudo palette entry written directly */
+	pseudo_palette[15] = 0x07e0;
+	model = fill_pattern(info);
+	CHECK(model != NULL);
+	if (!model)
+		return;
+	blit(info, model, 8, 16, 8, 16);
+	CHECK(screen_matches(info, model));
+	free(model);
+}
+
+#define TEST(fn)	{ #fn, fn }
+
+static const struct {
+	const char *name;
+	void (*fn)(const struct panel_case *, struct fb_info *);
+} tests[] = {
+	TEST(test_probe),
+	TEST(test_check_var),
+	TEST(test_set_par_unchanged),
+	TEST(test_set_par_vblank),
+	TEST(test_set_par_idle),
+	TEST(test_mode_switch),
+	TEST(test_setcmap),
+	TEST(test_pan),
+	TEST(test_pan_packed),
+	TEST(test_flip_queue),
+	TEST(test_wait_for_vsync),
+	TEST(test_get_buffer),
+	TEST(test_phys_flip),
+	TEST(test_yuv422),
+	TEST(test_yuv420),
+	TEST(test_read_write),
+	TEST(test_write_flip),
+	TEST(test_interrupt),
+	TEST(test_interrupt_staged),
+	TEST(test_interrupt_unregistered),
+	TEST(test_suspend_resume),
+	TEST(test_osd),
+	TEST(test_convert),
+	TEST(test_convert_write_flip),
+	TEST(test_defio_pan),
+	TEST(test_fastboot),
+	TEST(test_fillrect),
+	TEST(test_copyarea),
+	TEST(test_imageblit),
+	TEST(test_imageblit_cmap),
+};
+
+int main(int argc, char *argv[])
+{
+	char name[64];
+	struct fb_info *info;
+	unsigned int i, j;
+	int run = 0;
+
+	mock_verbose = getenv("MOCK_VERBOSE") != NULL;
+
+	for (i = 0; i < ARRAY_SIZE(panel_cases); i++) {
+		for (j = 0; j < ARRAY_SIZE(tests); j++) {
+			snprintf(name, sizeof(name), "%s %s@%lukHz",
+				tests[j].name, panel_cases[i].mode,
+				panel_cases[i].clk_khz);
+			current = name;
+
+			/* each test starts from a freshly probed device */
+			info = probe_panel(&panel_cases[i]);
+			CHECK(info != NULL);
+			if (!info)
+				continue;
+
+			tests[j].fn(&panel_cases[i], info);
+			remove_panel();
+			run++;
+		}
+	}
+
+	printf("%d tests, %d failures\n", run, failures);
+	return failures ? 1 : 0;
+}